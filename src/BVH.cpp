@@ -0,0 +1,451 @@
+#include "BVH.h"
+#include "RenderStats.h"
+
+//--------------------------------------------------------------
+
+void BVH::build(const vector<shared_ptr<SceneObject>>& objects, const vector<int>& objectIndices)
+{
+	this->objects = &objects;
+	nodes.clear();
+	leafObjects.clear();
+
+	if (objectIndices.empty())
+		return;
+
+	vector<BuildObject> buildObjects;
+	buildObjects.reserve(objectIndices.size());
+
+	for (int i : objectIndices)
+	{
+		BuildObject buildObject;
+		buildObject.index = i;
+		buildObject.bounds = objects[i]->getBounds();
+		buildObject.centroid = buildObject.bounds.getCenter();
+		buildObjects.push_back(buildObject);
+	}
+
+	//a binary tree with n leaves has 2n - 1 nodes, so this is an upper bound
+	nodes.reserve(2 * buildObjects.size());
+	buildNode(buildObjects, 0, buildObjects.size(), 0);
+
+	leafObjects.reserve(buildObjects.size());
+	for (BuildObject& buildObject : buildObjects)
+		leafObjects.push_back(buildObject.index);
+
+	copyShapes();
+}
+
+void BVH::refit()
+{
+	//children always come after their parents, so going through the nodes backwards refits both children of a node before the node itself
+	for (int i = (int)nodes.size() - 1; i >= 0; i--)
+	{
+		Node& node = nodes[i];
+		node.bounds = AABB();
+
+		if (node.numObjects > 0)
+		{
+			for (int j = node.offset; j < node.offset + node.numObjects; j++)
+				node.bounds.grow((*objects)[leafObjects[j]]->getBounds());
+		}
+		else
+		{
+			node.bounds.grow(nodes[i + 1].bounds);
+			node.bounds.grow(nodes[node.offset].bounds);
+		}
+	}
+
+	//the copies of the objects' shapes have to move with them
+	copyShapes();
+}
+
+void BVH::copyShapes()
+{
+	leafPrimitives.clear();
+	leafPrimitives.reserve(leafObjects.size());
+
+	for (int objectIndex : leafObjects)
+	{
+		LeafPrimitive primitive;
+		primitive.shape = (*objects)[objectIndex]->getShape();
+		primitive.objectIndex = objectIndex;
+		primitive.statsType = (*objects)[objectIndex]->getPrimitiveType();
+		leafPrimitives.push_back(primitive);
+	}
+}
+
+int BVH::buildNode(vector<BuildObject>& buildObjects, int begin, int end, int depth)
+{
+	int nodeIndex = nodes.size();
+	nodes.push_back(Node());
+
+	AABB bounds, centroidBounds;
+	for (int i = begin; i < end; i++)
+	{
+		bounds.grow(buildObjects[i].bounds);
+		centroidBounds.grow(buildObjects[i].centroid);
+	}
+
+	int numObjects = end - begin;
+
+	nodes[nodeIndex].bounds = bounds;
+	nodes[nodeIndex].offset = begin;
+	nodes[nodeIndex].numObjects = numObjects;
+	nodes[nodeIndex].axis = 0;
+
+	if (numObjects == 1 || depth >= MAX_DEPTH)
+		return nodeIndex;
+
+	//bin the object centroids along each axis and sweep the bins to find the split with the lowest surface area heuristic cost
+	float parentArea = bounds.getSurfaceArea();
+	float bestCost = std::numeric_limits<float>::infinity();
+	int bestAxis = -1;
+	int bestSplit = -1;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float axisMin = centroidBounds.minCorner[axis];
+		float axisExtent = centroidBounds.maxCorner[axis] - axisMin;
+
+		//every centroid is at the same spot on this axis, so splitting along it can't separate anything
+		if (axisExtent <= 0)
+			continue;
+
+		AABB binBounds[NUM_BINS];
+		int binCounts[NUM_BINS] = { 0 };
+
+		for (int i = begin; i < end; i++)
+		{
+			int bin = min(NUM_BINS - 1, (int)(NUM_BINS * (buildObjects[i].centroid[axis] - axisMin) / axisExtent));
+			binBounds[bin].grow(buildObjects[i].bounds);
+			binCounts[bin]++;
+		}
+
+		//rightArea[i] and rightCount[i] describe everything in bins i and above
+		float rightArea[NUM_BINS];
+		int rightCount[NUM_BINS];
+		AABB rightBounds;
+		int count = 0;
+
+		for (int bin = NUM_BINS - 1; bin > 0; bin--)
+		{
+			rightBounds.grow(binBounds[bin]);
+			count += binCounts[bin];
+			rightArea[bin] = rightBounds.getSurfaceArea();
+			rightCount[bin] = count;
+		}
+
+		AABB leftBounds;
+		int leftCount = 0;
+
+		//splitting at bin i puts bins [0, i) on the left and [i, NUM_BINS) on the right
+		for (int split = 1; split < NUM_BINS; split++)
+		{
+			leftBounds.grow(binBounds[split - 1]);
+			leftCount += binCounts[split - 1];
+
+			if (leftCount == 0 || rightCount[split] == 0)
+				continue;
+
+			float cost = TRAVERSAL_COST + (leftCount * leftBounds.getSurfaceArea() + rightCount[split] * rightArea[split]) / parentArea;
+
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = split;
+			}
+		}
+	}
+
+	//if nothing can be split apart or splitting costs more than just testing everything, then make this a leaf
+	if (bestAxis == -1 || (bestCost >= numObjects && numObjects <= MAX_LEAF_SIZE))
+		return nodeIndex;
+
+	int mid;
+
+	if (bestCost < numObjects)
+	{
+		float axisMin = centroidBounds.minCorner[bestAxis];
+		float axisExtent = centroidBounds.maxCorner[bestAxis] - axisMin;
+
+		auto middle = std::partition(buildObjects.begin() + begin, buildObjects.begin() + end, [&](const BuildObject& b)
+		{
+			int bin = min(NUM_BINS - 1, (int)(NUM_BINS * (b.centroid[bestAxis] - axisMin) / axisExtent));
+			return bin < bestSplit;
+		});
+
+		mid = middle - buildObjects.begin();
+	}
+	//the leaf is too big to keep, so fall back on splitting the objects in half along the split axis
+	else
+	{
+		mid = (begin + end) / 2;
+
+		std::nth_element(buildObjects.begin() + begin, buildObjects.begin() + mid, buildObjects.begin() + end, [&](const BuildObject& a, const BuildObject& b)
+		{
+			return a.centroid[bestAxis] < b.centroid[bestAxis];
+		});
+	}
+
+	buildNode(buildObjects, begin, mid, depth + 1);
+	int rightChild = buildNode(buildObjects, mid, end, depth + 1);
+
+	//the nodes vector may have been reallocated by the recursive calls, so the node has to be looked up again
+	nodes[nodeIndex].offset = rightChild;
+	nodes[nodeIndex].numObjects = 0;
+	nodes[nodeIndex].axis = bestAxis;
+
+	return nodeIndex;
+}
+
+//--------------------------------------------------------------
+
+bool BVH::intersectPrimitive(const LeafPrimitive& primitive, const Ray& ray, HitRecord& hit) const
+{
+	switch (primitive.shape.type)
+	{
+	case PrimitiveShape::Type::SPHERE: return primitive.shape.sphere.intersects(ray, hit.point, hit.distance);
+	case PrimitiveShape::Type::QUAD: return primitive.shape.quad.intersects(ray, hit.point, hit.distance);
+	default: return (*objects)[primitive.objectIndex]->intersects(ray, hit);
+	}
+}
+
+bool BVH::intersect(const Ray& ray, HitRecord& closestHit) const
+{
+	if (nodes.empty())
+		return false;
+
+	const glm::vec3& invDirection = ray.invDirection;
+	RenderStats* stats = RenderStats::current();
+
+	int closestObject = -1;
+	bool closestHasShape = false;
+	float closestDistance = ray.maxDistance;
+
+	int stack[STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0)
+	{
+		int nodeIndex = stack[--stackSize];
+		const Node& node = nodes[nodeIndex];
+
+		//skip the node if it is missed entirely or if it starts behind the closest hit we've already found
+		if (stats)
+			stats->nodeTests++;
+
+		float tEntry;
+		if (!node.bounds.intersects(ray.origin, invDirection, closestDistance, tEntry))
+			continue;
+
+		if (node.numObjects > 0)
+		{
+			for (int i = node.offset; i < node.offset + node.numObjects; i++)
+			{
+				const LeafPrimitive& primitive = leafPrimitives[i];
+				HitRecord hit;
+
+				bool isHit = intersectPrimitive(primitive, ray, hit);
+
+				if (stats)
+					stats->countTest(primitive.statsType, isHit);
+
+				if (isHit)
+				{
+					int objectIndex = primitive.objectIndex;
+
+					if (hit.distance < closestDistance || (hit.distance == closestDistance && objectIndex < closestObject))
+					{
+						closestDistance = hit.distance;
+						closestObject = objectIndex;
+						closestHasShape = primitive.shape.type != PrimitiveShape::Type::NONE;
+						closestHit = hit;
+					}
+				}
+			}
+		}
+		else
+		{
+			//push the far child first so that the near child gets popped (and visited) first
+			int leftChild = nodeIndex + 1;
+			int rightChild = node.offset;
+
+			if (ray.direction[node.axis] > 0)
+			{
+				stack[stackSize++] = rightChild;
+				stack[stackSize++] = leftChild;
+			}
+			else
+			{
+				stack[stackSize++] = leftChild;
+				stack[stackSize++] = rightChild;
+			}
+		}
+	}
+
+	if (closestObject == -1)
+		return false;
+
+	//the shapes only find where the hit is, so the object itself is asked for the rest of the hit (it does the same math, plus things like normal maps and texture coordinates).
+	//This is the only virtual call made for objects with a shape
+	if (closestHasShape)
+		(*objects)[closestObject]->intersects(ray, closestHit);
+
+	closestHit.objectIndex = closestObject;
+	return true;
+}
+
+void BVH::intersectPacket(const RayPacket& packet, int* closestObjects) const
+{
+	alignas(32) float closestDistances[RayPacket::SIZE];
+	alignas(32) float distances[RayPacket::SIZE];
+
+	int firstLane = -1;
+	for (int lane = 0; lane < RayPacket::SIZE; lane++)
+	{
+		closestObjects[lane] = -1;
+		closestDistances[lane] = packet.maxDistance[lane];
+
+		if (firstLane == -1 && packet.isActive(lane))
+			firstLane = lane;
+	}
+
+	if (nodes.empty() || firstLane == -1)
+		return;
+
+	RenderStats* stats = RenderStats::current();
+	int numActiveLanes = simd::countLanes(packet.activeLanes);
+
+	int stack[STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0)
+	{
+		int nodeIndex = stack[--stackSize];
+		const Node& node = nodes[nodeIndex];
+
+		//every active lane is tested against the node's box, which is what a packet saves over tracing the rays one at a time
+		if (stats)
+			stats->nodeTests += numActiveLanes;
+
+		//only the lanes that hit the node (in front of their closest hit so far) go any further. If none do, the whole subtree is skipped
+		int lanes = packet.intersects(node.bounds, closestDistances, packet.activeLanes);
+		if (lanes == 0)
+			continue;
+
+		if (node.numObjects > 0)
+		{
+			for (int i = node.offset; i < node.offset + node.numObjects; i++)
+			{
+				const LeafPrimitive& primitive = leafPrimitives[i];
+				int objectIndex = primitive.objectIndex;
+				int hitLanes;
+
+				switch (primitive.shape.type)
+				{
+				case PrimitiveShape::Type::SPHERE: hitLanes = primitive.shape.sphere.intersectPacket(packet, lanes, distances); break;
+				case PrimitiveShape::Type::QUAD: hitLanes = primitive.shape.quad.intersectPacket(packet, lanes, distances); break;
+				default: hitLanes = (*objects)[objectIndex]->intersectPacket(packet, lanes, distances); break;
+				}
+
+				if (stats)
+				{
+					RenderStats::PrimitiveType type = primitive.statsType;
+					stats->intersectionTests[type] += simd::countLanes(lanes);
+					stats->intersectionHits[type] += simd::countLanes(hitLanes);
+				}
+
+				for (int lane = 0; hitLanes != 0; lane++, hitLanes >>= 1)
+				{
+					//ties are broken the same way as in intersect()
+					if ((hitLanes & 1) && (distances[lane] < closestDistances[lane] || (distances[lane] == closestDistances[lane] && objectIndex < closestObjects[lane])))
+					{
+						closestDistances[lane] = distances[lane];
+						closestObjects[lane] = objectIndex;
+					}
+				}
+			}
+		}
+		else
+		{
+			//the rays in a packet point in nearly the same direction, so the first one decides which child is in front for all of them
+			int leftChild = nodeIndex + 1;
+			int rightChild = node.offset;
+
+			if (packet.direction[node.axis][firstLane] > 0)
+			{
+				stack[stackSize++] = rightChild;
+				stack[stackSize++] = leftChild;
+			}
+			else
+			{
+				stack[stackSize++] = leftChild;
+				stack[stackSize++] = rightChild;
+			}
+		}
+	}
+}
+
+bool BVH::occludes(const Ray& ray, int* occluder) const
+{
+	if (nodes.empty())
+		return false;
+
+	const glm::vec3& invDirection = ray.invDirection;
+	RenderStats* stats = RenderStats::current();
+
+	int stack[STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0)
+	{
+		int nodeIndex = stack[--stackSize];
+		const Node& node = nodes[nodeIndex];
+
+		if (stats)
+			stats->nodeTests++;
+
+		float tEntry;
+		if (!node.bounds.intersects(ray.origin, invDirection, ray.maxDistance, tEntry))
+			continue;
+
+		if (node.numObjects > 0)
+		{
+			for (int i = node.offset; i < node.offset + node.numObjects; i++)
+			{
+				const LeafPrimitive& primitive = leafPrimitives[i];
+				bool occluded;
+
+				switch (primitive.shape.type)
+				{
+				case PrimitiveShape::Type::SPHERE: occluded = primitive.shape.sphere.occludes(ray); break;
+				case PrimitiveShape::Type::QUAD: occluded = primitive.shape.quad.occludes(ray); break;
+				default: occluded = (*objects)[primitive.objectIndex]->occludes(ray); break;
+				}
+
+				if (stats)
+					stats->countTest(primitive.statsType, occluded);
+
+				if (occluded)
+				{
+					if (occluder)
+						*occluder = primitive.objectIndex;
+
+					return true;
+				}
+			}
+		}
+		else
+		{
+			//for shadow rays any hit will do, so the order doesn't matter
+			stack[stackSize++] = node.offset;
+			stack[stackSize++] = nodeIndex + 1;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "GraphicalStructs.h"
+#include "SceneObjects.h"
+
+/// <summary>
+/// Bounding volume hierarchy over a set of scene objects, split using the surface area heuristic.
+/// The BVH only stores indices into the object list it was built from, so that list must not change until the BVH is rebuilt
+/// </summary>
+class BVH
+{
+public:
+	BVH() : objects(nullptr) {}
+
+	/// <summary>
+	/// Builds the hierarchy over objects[i] for every i in objectIndices
+	/// </summary>
+	void build(const vector<shared_ptr<SceneObject>>& objects, const vector<int>& objectIndices);
+
+	/// <summary>
+	/// Updates the bounds of every node after objects have moved (see Instance::setTransform), keeping the tree as it was built.
+	/// This is much quicker than building it again, but the tree gets slower to traverse the further the objects move from where it was built
+	/// </summary>
+	void refit();
+
+	/// <summary>
+	/// Finds the closest object hit by the ray, visiting nodes front to back so that anything behind the closest hit so far is skipped.
+	/// Returns false if nothing was hit. Otherwise hit is filled in by the object that was hit, and hit.objectIndex is its index into the list the BVH was built from
+	/// </summary>
+	bool intersect(const Ray& ray, HitRecord& hit) const;
+
+	/// <summary>
+	/// Finds the closest object hit by each active lane of the packet, with every lane walking the tree together so that each node's box is tested against all of them at once.
+	/// closestObjects gets one object index per lane (-1 for lanes that miss or aren't active)
+	/// </summary>
+	void intersectPacket(const RayPacket& packet, int* closestObjects) const;
+
+	/// <summary>
+	/// Returns true as soon as any object occludes the ray (see SceneObject::occludes) between its origin and ray.maxDistance.
+	/// If occluder is given, it gets the index of the object that did
+	/// </summary>
+	bool occludes(const Ray& ray, int* occluder = nullptr) const;
+
+	bool isEmpty() const { return nodes.empty(); }
+
+	friend class SceneSnapshot; //reads and writes baked scene files
+
+private:
+	static const int NUM_BINS = 16;
+	static const int MAX_LEAF_SIZE = 4;
+	static const int MAX_DEPTH = 48;
+	static const int STACK_SIZE = MAX_DEPTH + 16;
+
+	//relative to the cost of one object intersection test
+	const float TRAVERSAL_COST = .5;
+
+	struct Node
+	{
+		AABB bounds;
+		int offset; //the index of the right child for interior nodes (the left child always comes right after its parent), or the first object for leaves
+		int numObjects; //0 for interior nodes
+		int axis; //the axis an interior node was split along, used to decide which child is in front
+	};
+
+	struct BuildObject
+	{
+		int index;
+		AABB bounds;
+		glm::vec3 centroid;
+	};
+
+	//a leaf object along with a copy of its shape, if it has one (see SceneObject::getShape)
+	struct LeafPrimitive
+	{
+		PrimitiveShape shape;
+		int objectIndex;
+		RenderStats::PrimitiveType statsType; //copied too, so that counting a test doesn't take a virtual call
+	};
+
+	const vector<shared_ptr<SceneObject>>* objects;
+
+	vector<Node> nodes;
+	vector<int> leafObjects; //objects referenced by the leaves, grouped so that every leaf's objects are contiguous
+	vector<LeafPrimitive> leafPrimitives; //the same objects in the same order, which is what traversal actually reads
+
+	/// <summary>
+	/// Fills in leafPrimitives from leafObjects
+	/// </summary>
+	void copyShapes();
+
+	/// <summary>
+	/// Intersects a single leaf primitive, going through the object's virtual functions only if it doesn't have a shape.
+	/// Only the distance and point are filled in for objects with a shape, since that's all the shapes find
+	/// </summary>
+	bool intersectPrimitive(const LeafPrimitive& primitive, const Ray& ray, HitRecord& hit) const;
+
+	int buildNode(vector<BuildObject>& buildObjects, int begin, int end, int depth);
+};
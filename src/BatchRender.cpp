@@ -0,0 +1,548 @@
+#include "BatchRender.h"
+#include "ofMain.h"
+#include "Scene.h"
+#include "Scenes.h"
+#include "Renderer.h"
+#include "SceneSnapshot.h"
+#include "Benchmark.h"
+#include "Sequence.h"
+#include "DistributedRender.h"
+#include <climits>
+
+//--------------------------------------------------------------
+
+struct BatchRenderOptions
+{
+	string sceneName = "moon";
+	string outputPath = "renderedScene.png";
+	string bakePath; //if set, the scene is baked to this file instead of being rendered
+	string snapshotPath; //if set, the scene is loaded from this baked file instead of being built by name
+	string benchmarkPath; //if set, the benchmarks are run with their reference images in this directory instead of rendering anything
+	string sequencePath; //if set, the frames of the keyframes in this file are rendered instead of a single image
+	int numFrames = 1;
+
+	int listenPort = 0; //if set, this process hands out jobs to workers on this port instead of rendering anything itself
+	int jobSize = 256;
+	int workerTimeout = 600;
+	string workerAddress; //if set, this process renders jobs for the coordinator at this HOST:PORT, and every other option but --threads comes from the coordinator
+
+	//the defaults match sceneCam in ofApp::setup and the window size in main
+	glm::vec3 cameraPosition = glm::vec3(0, 2, 15);
+	glm::vec3 cameraTarget = glm::vec3(0, 0, 0);
+	float fov = 60;
+	int width = 1200;
+	int height = 700;
+
+	RenderSettings renderSettings;
+	BenchmarkOptions benchmarkOptions;
+};
+
+static void printUsage(const char* program)
+{
+	cout << "Usage: " << program << " [options]\n"
+		<< "  --scene NAME            scene to render (default moon)\n"
+		<< "  --camera X,Y,Z,TX,TY,TZ camera position and the point it looks at (default 0,2,15,0,0,0)\n"
+		<< "  --fov DEGREES           vertical field of view (default 60)\n"
+		<< "  --width PIXELS          image width (default 1200)\n"
+		<< "  --height PIXELS         image height (default 700)\n"
+		<< "  --threads N             number of render threads, 0 for every core (default 0)\n"
+		<< "  --tile-size PIXELS      width and height of the tiles handed to each thread (default 32)\n"
+		<< "  --packets on|off        trace primary rays in SIMD packets (default on)\n"
+		<< "  --samples MIN,MAX       adaptive anti-aliasing: every pixel gets MIN samples, and up to MAX where it needs them (default 4,1, which is off)\n"
+		<< "  --aa-threshold N        how uncertain a pixel's color (0-255) can be before it gets more samples (default 4)\n"
+		<< "  --max-depth N           the most reflections in a row a ray can go through (default 8)\n"
+		<< "  --min-weight W          skip reflections that would add less than W of the pixel's color (default 0.0039)\n"
+		<< "  --roulette on|off       trace low weight reflections at random instead of skipping them (default off)\n"
+		<< "  --irradiance-cache S    interpolate diffuse lighting from samples S apart instead of tracing shadow rays at every hit (default off)\n"
+		<< "  --output PATH           where to save the image (default renderedScene.png). Render statistics are saved next to it as NAME.stats.json\n"
+		<< "  --checkpoint PATH       save the finished tiles to this file as the render goes, and resume from it if it's already there\n"
+		<< "  --checkpoint-interval S how many seconds apart --checkpoint is saved (default 60)\n"
+		<< "  --sequence PATH         render the frames of the camera and object keyframes in this file, numbering each frame's image after --output\n"
+		<< "  --frames N              how many frames --sequence renders, spread evenly over its keyframes (default 1)\n"
+		<< "  --bake PATH             bake the scene into a snapshot file instead of rendering it\n"
+		<< "  --snapshot PATH         render a scene baked with --bake instead of building one with --scene\n"
+		<< "  --listen PORT           split the render into jobs for workers that connect to this port, and stitch their results together\n"
+		<< "  --job-size PIXELS       width and height of the jobs handed to each worker (default 256)\n"
+		<< "  --worker-timeout S      seconds a worker can go without sending anything before its job goes to another one (default 600)\n"
+		<< "  --worker HOST:PORT      render jobs for the coordinator at HOST:PORT, using its options (except --threads) instead of this command line\n"
+		<< "  --benchmark DIR         run the benchmarks, checking their images against the references in DIR (uses --threads)\n"
+		<< "  --benchmark-runs N      how many times each benchmark scene is rendered (default 3)\n"
+		<< "  --tolerance N           how far a benchmark pixel may be from its reference (default 8)\n"
+		<< "  --update-references     save the image of a benchmark with no reference as its reference, instead of failing\n"
+		<< "  --help                  show this message\n"
+		<< "Available scenes:";
+
+	for (const string& name : getSceneNames())
+		cout << " " << name;
+
+	cout << endl;
+}
+
+static bool parseVec3Pair(const string& arg, glm::vec3& first, glm::vec3& second)
+{
+	vector<string> values = ofSplitString(arg, ",");
+
+	if (values.size() != 6)
+		return false;
+
+	for (int i = 0; i < 3; i++)
+	{
+		first[i] = ofToFloat(values[i]);
+		second[i] = ofToFloat(values[i + 3]);
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Fills in options from the command line. Returns false (after printing why) if the arguments don't make sense
+/// </summary>
+static bool parseArguments(int argc, char* argv[], BatchRenderOptions& options, bool& showHelp)
+{
+	showHelp = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+
+		if (arg == "--help" || arg == "-h")
+		{
+			showHelp = true;
+			return true;
+		}
+
+		//the only option that doesn't take a value
+		if (arg == "--update-references")
+		{
+			options.benchmarkOptions.updateReferences = true;
+			continue;
+		}
+
+		//every other option takes a value
+		if (i + 1 >= argc)
+		{
+			cerr << "Missing value for " << arg << endl;
+			return false;
+		}
+
+		string value = argv[++i];
+
+		if (arg == "--scene")
+			options.sceneName = value;
+		else if (arg == "--output")
+			options.outputPath = value;
+		else if (arg == "--bake")
+			options.bakePath = value;
+		else if (arg == "--snapshot")
+			options.snapshotPath = value;
+		else if (arg == "--benchmark")
+			options.benchmarkPath = value;
+		else if (arg == "--checkpoint")
+			options.renderSettings.checkpointPath = value;
+		else if (arg == "--checkpoint-interval")
+			options.renderSettings.checkpointInterval = ofToFloat(value);
+		else if (arg == "--sequence")
+			options.sequencePath = value;
+		else if (arg == "--frames")
+			options.numFrames = ofToInt(value);
+		else if (arg == "--listen")
+			options.listenPort = ofToInt(value);
+		else if (arg == "--job-size")
+			options.jobSize = ofToInt(value);
+		else if (arg == "--worker-timeout")
+			options.workerTimeout = ofToInt(value);
+		else if (arg == "--worker")
+			options.workerAddress = value;
+		else if (arg == "--benchmark-runs")
+			options.benchmarkOptions.renderRuns = ofToInt(value);
+		else if (arg == "--tolerance")
+			options.benchmarkOptions.tolerance = ofToInt(value);
+		else if (arg == "--camera")
+		{
+			if (!parseVec3Pair(value, options.cameraPosition, options.cameraTarget))
+			{
+				cerr << "--camera takes six comma separated numbers, got " << value << endl;
+				return false;
+			}
+		}
+		else if (arg == "--fov")
+			options.fov = ofToFloat(value);
+		else if (arg == "--width")
+			options.width = ofToInt(value);
+		else if (arg == "--height")
+			options.height = ofToInt(value);
+		else if (arg == "--threads")
+			options.renderSettings.numThreads = ofToInt(value);
+		else if (arg == "--tile-size")
+			options.renderSettings.tileSize = ofToInt(value);
+		else if (arg == "--packets" && (value == "on" || value == "off"))
+			options.renderSettings.usePacketTracing = value == "on";
+		else if (arg == "--samples")
+		{
+			vector<string> values = ofSplitString(value, ",");
+
+			if (values.size() != 2)
+			{
+				cerr << "--samples takes two comma separated numbers, got " << value << endl;
+				return false;
+			}
+
+			options.renderSettings.minSamples = ofToInt(values[0]);
+			options.renderSettings.maxSamples = ofToInt(values[1]);
+		}
+		else if (arg == "--aa-threshold")
+			options.renderSettings.aaThreshold = ofToFloat(value);
+		else if (arg == "--max-depth")
+			options.renderSettings.reflectionLimits.maxDepth = ofToInt(value);
+		else if (arg == "--min-weight")
+			options.renderSettings.reflectionLimits.minWeight = ofToFloat(value);
+		else if (arg == "--roulette" && (value == "on" || value == "off"))
+			options.renderSettings.reflectionLimits.russianRoulette = value == "on";
+		else if (arg == "--irradiance-cache")
+		{
+			options.renderSettings.irradianceCache.enabled = true;
+			options.renderSettings.irradianceCache.spacing = ofToFloat(value);
+
+			if (options.renderSettings.irradianceCache.spacing <= 0)
+			{
+				cerr << "--irradiance-cache takes a spacing above 0, got " << value << endl;
+				return false;
+			}
+		}
+		else
+		{
+			cerr << "Unknown option " << arg << endl;
+			return false;
+		}
+	}
+
+	if (!options.bakePath.empty() && !options.snapshotPath.empty())
+	{
+		cerr << "--bake and --snapshot can't be used together" << endl;
+		return false;
+	}
+
+	if (!options.sequencePath.empty() && !options.bakePath.empty())
+	{
+		cerr << "--sequence and --bake can't be used together" << endl;
+		return false;
+	}
+
+	if (options.listenPort != 0 && (!options.workerAddress.empty() || !options.bakePath.empty()))
+	{
+		cerr << "--listen can't be used with --worker or --bake" << endl;
+		return false;
+	}
+
+	//a checkpoint holds the tiles of one image, and the jobs of a distributed render are already redone when a worker goes away
+	if (!options.renderSettings.checkpointPath.empty() && (!options.sequencePath.empty() || options.listenPort != 0))
+	{
+		cerr << "--checkpoint can't be used with --sequence or --listen" << endl;
+		return false;
+	}
+
+	if (options.renderSettings.checkpointInterval <= 0)
+	{
+		cerr << "--checkpoint-interval has to be above 0" << endl;
+		return false;
+	}
+
+	if (options.listenPort < 0 || options.listenPort > 65535 || options.jobSize <= 0)
+	{
+		cerr << "The port has to be between 1 and 65535, and the job size has to be positive" << endl;
+		return false;
+	}
+
+	//the timeout is given to the socket in milliseconds
+	if (options.workerTimeout <= 0 || options.workerTimeout > INT_MAX / 1000)
+	{
+		cerr << "--worker-timeout has to be a positive number of seconds" << endl;
+		return false;
+	}
+
+	if (options.numFrames <= 0)
+	{
+		cerr << "A sequence has to have at least one frame" << endl;
+		return false;
+	}
+
+	if (options.benchmarkOptions.renderRuns <= 0 || options.benchmarkOptions.tolerance < 0)
+	{
+		cerr << "The benchmark has to render each scene at least once, and the tolerance can't be negative" << endl;
+		return false;
+	}
+
+	if (options.width <= 0 || options.height <= 0)
+	{
+		cerr << "The image has to be at least 1x1 pixels" << endl;
+		return false;
+	}
+
+	if (options.fov <= 0 || options.fov >= 180)
+	{
+		cerr << "The field of view has to be between 0 and 180 degrees" << endl;
+		return false;
+	}
+
+	if (options.renderSettings.numThreads < 0 || options.renderSettings.tileSize <= 0)
+	{
+		cerr << "The thread count can't be negative and the tile size has to be positive" << endl;
+		return false;
+	}
+
+	if (options.renderSettings.minSamples <= 0 || options.renderSettings.maxSamples <= 0 || options.renderSettings.aaThreshold < 0)
+	{
+		cerr << "Every pixel needs at least one sample, and the anti-aliasing threshold can't be negative" << endl;
+		return false;
+	}
+
+	if (options.renderSettings.reflectionLimits.maxDepth < 0 || options.renderSettings.reflectionLimits.minWeight < 0)
+	{
+		cerr << "The reflection depth and weight limits can't be negative" << endl;
+		return false;
+	}
+
+	if (options.cameraPosition == options.cameraTarget)
+	{
+		cerr << "The camera can't look at its own position" << endl;
+		return false;
+	}
+
+	return true;
+}
+
+//--------------------------------------------------------------
+
+/// <summary>
+/// Loads the scene named by the options, or their snapshot if they have one (in which case the snapshot's path becomes the scene name)
+/// </summary>
+static bool loadScene(BatchRenderOptions& options, Scene& scene)
+{
+	if (options.snapshotPath.empty())
+		return loadSceneByName(options.sceneName, scene);
+
+	if (!SceneSnapshot::load(options.snapshotPath, scene))
+		return false;
+
+	options.sceneName = options.snapshotPath;
+	return true;
+}
+
+/// <summary>
+/// Hands the render out to workers with --listen. The coordinator doesn't load the scene itself, so only what it can check cheaply is checked before waiting for workers
+/// </summary>
+static int runCoordinator(const BatchRenderOptions& options, int argc, char* argv[])
+{
+	vector<string> sceneNames = getSceneNames();
+
+	if (options.snapshotPath.empty() && std::find(sceneNames.begin(), sceneNames.end(), options.sceneName) == sceneNames.end())
+	{
+		cerr << "There is no scene named " << options.sceneName << endl;
+		return BATCH_RENDER_SCENE_FAILED;
+	}
+
+	Sequence sequence;
+	if (!options.sequencePath.empty() && !sequence.load(options.sequencePath))
+		return BATCH_RENDER_BAD_ARGUMENTS;
+
+	CoordinatorOptions coordinatorOptions;
+	coordinatorOptions.port = options.listenPort;
+	coordinatorOptions.jobSize = options.jobSize;
+	coordinatorOptions.workerTimeout = options.workerTimeout;
+	coordinatorOptions.outputPath = options.outputPath;
+	coordinatorOptions.numFrames = options.sequencePath.empty() ? 1 : options.numFrames;
+	coordinatorOptions.width = options.width;
+	coordinatorOptions.height = options.height;
+	coordinatorOptions.tileSize = options.renderSettings.tileSize;
+
+	//the workers get the rest of the command line, and pick their own thread counts
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+
+		//the one option without a value only matters to the benchmark
+		if (arg == "--update-references" || i + 1 >= argc)
+			continue;
+
+		string value = argv[++i];
+
+		if (arg != "--listen" && arg != "--job-size" && arg != "--worker-timeout" && arg != "--threads")
+		{
+			coordinatorOptions.workerArguments.push_back(arg);
+			coordinatorOptions.workerArguments.push_back(value);
+		}
+	}
+
+	cout << "Coordinating " << coordinatorOptions.numFrames << (coordinatorOptions.numFrames == 1 ? " frame" : " frames") << " of " << options.sceneName
+		<< " at " << options.width << "x" << options.height << "..." << endl;
+
+	return runTileCoordinator(coordinatorOptions) ? BATCH_RENDER_OK : BATCH_RENDER_SAVE_FAILED;
+}
+
+/// <summary>
+/// Renders jobs for the coordinator given with --worker, setting the scene up from the coordinator's command line
+/// </summary>
+static int runWorker(const BatchRenderOptions& workerOptions)
+{
+	Socket coordinator;
+	vector<string> arguments;
+
+	if (!connectToCoordinator(workerOptions.workerAddress, workerOptions.renderSettings.getNumThreads(), coordinator, arguments))
+		return BATCH_RENDER_BAD_ARGUMENTS;
+
+	//parsed just like a command line, which needs a program name in front
+	arguments.insert(arguments.begin(), "worker");
+	vector<char*> argv;
+	for (string& argument : arguments)
+		argv.push_back(&argument[0]);
+
+	BatchRenderOptions options;
+	bool showHelp;
+
+	if (!parseArguments(argv.size(), argv.data(), options, showHelp) || showHelp)
+	{
+		cerr << "Couldn't make sense of the coordinator's options" << endl;
+		return BATCH_RENDER_BAD_ARGUMENTS;
+	}
+
+	options.renderSettings.numThreads = workerOptions.renderSettings.numThreads;
+	options.renderSettings.printProgress = false;
+
+	Scene scene;
+	if (!loadScene(options, scene))
+		return BATCH_RENDER_SCENE_FAILED;
+
+	Sequence sequence;
+	if (!options.sequencePath.empty() && (!sequence.load(options.sequencePath) || !sequence.attach(scene)))
+		return BATCH_RENDER_SCENE_FAILED;
+
+	CameraKeyframe defaultCamera = { 0, options.cameraPosition, options.cameraTarget, options.fov };
+
+	cout << "Rendering " << options.sceneName << " for the coordinator at " << workerOptions.workerAddress << endl;
+
+	bool finished = runTileWorker(coordinator, scene, options.renderSettings, [&](int frame)
+	{
+		if (options.sequencePath.empty())
+			return PinholeCamera(options.cameraPosition, options.cameraTarget, options.fov, options.width, options.height);
+
+		float time = sequence.getFrameTime(frame, options.numFrames);
+
+		if (sequence.hasObjectKeyframes())
+		{
+			sequence.moveObjects(scene, time);
+			scene.refit();
+		}
+
+		return sequence.getCamera(time, defaultCamera, options.width, options.height);
+	});
+
+	if (!finished)
+	{
+		cerr << "Lost the connection to the coordinator" << endl;
+		return BATCH_RENDER_SAVE_FAILED;
+	}
+
+	return BATCH_RENDER_OK;
+}
+
+//--------------------------------------------------------------
+
+int runBatchRender(int argc, char* argv[])
+{
+	BatchRenderOptions options;
+	bool showHelp;
+
+	if (!parseArguments(argc, argv, options, showHelp))
+	{
+		printUsage(argv[0]);
+		return BATCH_RENDER_BAD_ARGUMENTS;
+	}
+
+	if (showHelp)
+	{
+		printUsage(argv[0]);
+		return BATCH_RENDER_OK;
+	}
+
+	//sets up the data path and everything else openFrameworks needs, without opening a window
+	ofInit();
+
+	if (!options.benchmarkPath.empty())
+	{
+		options.benchmarkOptions.referenceDirectory = options.benchmarkPath;
+		options.benchmarkOptions.numThreads = options.renderSettings.numThreads;
+
+		return runBenchmarks(options.benchmarkOptions) ? BATCH_RENDER_OK : BATCH_RENDER_BENCHMARK_FAILED;
+	}
+
+	if (!options.workerAddress.empty())
+		return runWorker(options);
+
+	if (options.listenPort != 0)
+		return runCoordinator(options, argc, argv);
+
+	Scene scene;
+
+	if (!loadScene(options, scene))
+		return BATCH_RENDER_SCENE_FAILED;
+
+	if (!options.bakePath.empty())
+	{
+		if (!SceneSnapshot::bake(scene, options.bakePath))
+			return BATCH_RENDER_SAVE_FAILED;
+
+		cout << "Baked " << options.sceneName << " to " << options.bakePath << endl;
+		return BATCH_RENDER_OK;
+	}
+
+	if (!options.sequencePath.empty())
+	{
+		Sequence sequence;
+
+		if (!sequence.load(options.sequencePath))
+			return BATCH_RENDER_BAD_ARGUMENTS;
+
+		if (!sequence.attach(scene))
+			return BATCH_RENDER_SCENE_FAILED;
+
+		SequenceOptions sequenceOptions;
+		sequenceOptions.outputPath = options.outputPath;
+		sequenceOptions.numFrames = options.numFrames;
+		sequenceOptions.width = options.width;
+		sequenceOptions.height = options.height;
+		sequenceOptions.defaultCamera = { 0, options.cameraPosition, options.cameraTarget, options.fov };
+		sequenceOptions.renderSettings = options.renderSettings;
+
+		cout << "Rendering " << options.numFrames << " frames of " << options.sequencePath << " in " << options.sceneName << " at " << options.width << "x" << options.height << "..." << endl;
+
+		return renderSequence(scene, sequence, sequenceOptions) ? BATCH_RENDER_OK : BATCH_RENDER_SAVE_FAILED;
+	}
+
+	PinholeCamera camera(options.cameraPosition, options.cameraTarget, options.fov, options.width, options.height);
+
+	cout << "Rendering " << options.sceneName << " at " << options.width << "x" << options.height << "..." << endl;
+
+	Renderer renderer(scene, options.renderSettings);
+	ofPixels pixels = renderer.render(camera);
+
+	if (!ofSaveImage(pixels, options.outputPath))
+	{
+		cerr << "Couldn't save the image to " << options.outputPath << endl;
+		return BATCH_RENDER_SAVE_FAILED;
+	}
+
+	cout << "Rendering complete. Image saved to " << options.outputPath << endl;
+
+	//the image is safe now, so the checkpoint isn't needed anymore (and would only be resumed by rendering the same thing again)
+	if (!options.renderSettings.checkpointPath.empty() && std::remove(options.renderSettings.checkpointPath.c_str()) == 0)
+		cout << "Removed the checkpoint " << options.renderSettings.checkpointPath << endl;
+
+	//the statistics are only there to help explain the render, so failing to save them doesn't fail the render
+	string statsPath = RenderStats::pathForImage(options.outputPath);
+	if (renderer.getStats().saveJson(statsPath))
+		cout << "Render statistics saved to " << statsPath << endl;
+	else
+		cerr << "Couldn't save the render statistics to " << statsPath << endl;
+
+	return BATCH_RENDER_OK;
+}
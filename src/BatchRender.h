@@ -0,0 +1,22 @@
+#pragma once
+
+/**
+ * Command line rendering without a window or GL context, so that renders can run on machines with no display.
+ *
+ * Usage: moonlight-raytracer --scene moon --width 1920 --height 1080 --threads 32 --output frame.png
+ * Run with --help to see every option
+ */
+
+enum BatchRenderStatus
+{
+	BATCH_RENDER_OK = 0,
+	BATCH_RENDER_BAD_ARGUMENTS = 1,
+	BATCH_RENDER_SCENE_FAILED = 2,
+	BATCH_RENDER_SAVE_FAILED = 3,
+	BATCH_RENDER_BENCHMARK_FAILED = 4 //an image made by --benchmark didn't match its reference
+};
+
+/// <summary>
+/// Parses the command line, renders the requested image and saves it. Returns one of the BatchRenderStatus codes, which main uses as the exit status
+/// </summary>
+int runBatchRender(int argc, char* argv[]);
@@ -0,0 +1,258 @@
+#include "Benchmark.h"
+#include "Scene.h"
+#include "Scenes.h"
+#include "Renderer.h"
+#include "SphereObjects.h"
+#include "PlaneObjects.h"
+#include "BoxObjects.h"
+#include <chrono>
+#include <random>
+
+//--------------------------------------------------------------
+
+static const int KERNEL_CALLS = 1 << 21;
+static const int KERNEL_RUNS = 5;
+static const int NUM_KERNEL_INPUTS = 4096; //small enough to stay in cache, so the kernels are timed rather than memory
+
+/// <summary>
+/// Calls kernel(i) KERNEL_CALLS times, KERNEL_RUNS times over, and prints the fastest time per call. kernel returns whether it hit, which is also
+/// what keeps the compiler from optimizing the calls away
+/// </summary>
+template<typename Kernel>
+static void timeKernel(const string& name, Kernel kernel)
+{
+	double bestNanoseconds = std::numeric_limits<double>::infinity();
+	int hits = 0;
+
+	for (int run = 0; run < KERNEL_RUNS; run++)
+	{
+		hits = 0;
+
+		auto t1 = std::chrono::high_resolution_clock::now();
+
+		for (int i = 0; i < KERNEL_CALLS; i++)
+			hits += kernel(i % NUM_KERNEL_INPUTS);
+
+		auto t2 = std::chrono::high_resolution_clock::now();
+		bestNanoseconds = min(bestNanoseconds, std::chrono::duration<double, std::nano>(t2 - t1).count() / KERNEL_CALLS);
+	}
+
+	cout << "  " << left << setw(40) << name << right << fixed << setprecision(1) << setw(8) << bestNanoseconds << " ns/call"
+		<< setw(8) << hits * 100.0 / KERNEL_CALLS << "% hit" << endl;
+}
+
+//rays from random points around the box, aimed at random points inside a slightly bigger box so that some of them miss
+static vector<Ray> makeRays(const AABB& target, std::mt19937& random)
+{
+	std::uniform_real_distribution<float> unit(-1, 1);
+
+	glm::vec3 center = target.getCenter();
+	glm::vec3 halfSize = (target.maxCorner - target.minCorner) * .5f;
+	float distance = glm::length(halfSize) * 4;
+
+	vector<Ray> rays;
+
+	while (rays.size() < NUM_KERNEL_INPUTS)
+	{
+		glm::vec3 offset(unit(random), unit(random), unit(random));
+		if (glm::length(offset) < .01)
+			continue;
+
+		glm::vec3 origin = center + glm::normalize(offset) * distance;
+		glm::vec3 aim = center + glm::vec3(unit(random), unit(random), unit(random)) * halfSize * 1.5f;
+
+		rays.push_back(Ray(origin, glm::normalize(aim - origin)));
+	}
+
+	return rays;
+}
+
+static void runKernelBenchmarks()
+{
+	cout << "Intersection kernels:" << endl;
+
+	//a fixed seed, so every run tests the same rays
+	std::mt19937 random(12345);
+	HitRecord hit;
+	glm::vec3 normal;
+
+	Sphere sphere(glm::vec3(0), 1, ofColor::white);
+	vector<Ray> sphereRays = makeRays(sphere.getBounds(), random);
+	timeKernel("Sphere::intersects", [&](int i) { return sphere.intersects(sphereRays[i], hit); });
+
+	Plane plane(glm::vec3(-1, 0, -1), 2, 2, Plane::Axis::XZ);
+	vector<Ray> planeRays = makeRays(AABB(glm::vec3(-1), glm::vec3(1)), random);
+	timeKernel("Plane::intersects", [&](int i) { return plane.intersects(planeRays[i], hit); });
+
+	Box box(glm::vec3(-1, 1, -1), glm::vec3(1, -1, 1), ofColor::white);
+	vector<Ray> boxRays = makeRays(box.getBounds(), random);
+	timeKernel("Box::intersects", [&](int i) { return box.intersects(boxRays[i], hit); });
+
+	glm::vec3 p0(-1, -1, 0), p1(1, -1, .5), p2(0, 1, -.5);
+	AABB triangleBounds;
+	triangleBounds.grow(p0);
+	triangleBounds.grow(p1);
+	triangleBounds.grow(p2);
+	vector<Ray> triangleRays = makeRays(triangleBounds, random);
+	timeKernel("DisplacementPlane::intersectsTriangle", [&](int i)
+	{
+		glm::vec3 baryCoords;
+		return DisplacementPlane::intersectsTriangle(triangleRays[i], p0, p1, p2, baryCoords, normal);
+	});
+
+	//a generated image, so the benchmark doesn't depend on any data files
+	ofPixels pixels;
+	pixels.allocate(512, 512, OF_IMAGE_COLOR);
+	for (int y = 0; y < 512; y++)
+	{
+		for (int x = 0; x < 512; x++)
+			pixels.setColor(x, y, ofColor(x / 2, y / 2, (x ^ y) & 255));
+	}
+
+	std::uniform_real_distribution<float> uv(-2, 2);
+	vector<glm::vec2> uvs;
+	for (int i = 0; i < NUM_KERNEL_INPUTS; i++)
+		uvs.push_back(glm::vec2(uv(random), uv(random)));
+
+	Texture nearest(pixels, Texture::Encoding::COLOR, Texture::Filter::NEAREST);
+	timeKernel("Texture::sample (nearest)", [&](int i) { return nearest.sample(uvs[i])[0] >= 128; });
+
+	Texture bilinear(pixels, Texture::Encoding::COLOR, Texture::Filter::BILINEAR);
+	timeKernel("Texture::sample (bilinear)", [&](int i) { return bilinear.sample(uvs[i])[0] >= 128; });
+}
+
+//--------------------------------------------------------------
+
+struct SceneBenchmark
+{
+	string name; //also the name of the reference image
+	string sceneName;
+	int width;
+	int height;
+	glm::vec3 cameraPosition;
+	glm::vec3 cameraTarget;
+	float fov;
+};
+
+static vector<SceneBenchmark> getSceneBenchmarks()
+{
+	//the moon scene is seen from sceneCam in ofApp::setup
+	return {
+		{ "moon-640x360", "moon", 640, 360, glm::vec3(0, 2, 15), glm::vec3(0, 0, 0), 60 },
+		{ "moon-1280x720", "moon", 1280, 720, glm::vec3(0, 2, 15), glm::vec3(0, 0, 0), 60 },
+		{ "gallery-960x540", "gallery", 960, 540, glm::vec3(0, 8, 16), glm::vec3(0, 0, -14), 60 },
+		{ "street-960x540", "street", 960, 540, glm::vec3(-60, 70, 110), glm::vec3(0, 0, 0), 60 },
+	};
+}
+
+/// <summary>
+/// Counts the pixels of image that have a channel (ignoring alpha) that is more than tolerance away from reference, and the biggest difference in any channel.
+/// Returns false if the images aren't the same size
+/// </summary>
+static bool compareImages(const ofPixels& image, const ofPixels& reference, int tolerance, int& differentPixels, int& maxDifference)
+{
+	if (image.getWidth() != reference.getWidth() || image.getHeight() != reference.getHeight())
+		return false;
+
+	int width = image.getWidth();
+	int height = image.getHeight();
+	differentPixels = 0;
+	maxDifference = 0;
+
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			ofColor a = image.getColor(x, y);
+			ofColor b = reference.getColor(x, y);
+			int difference = max(abs(a.r - b.r), max(abs(a.g - b.g), abs(a.b - b.b)));
+
+			maxDifference = max(maxDifference, difference);
+			differentPixels += difference > tolerance;
+		}
+	}
+
+	return true;
+}
+
+static bool runSceneBenchmark(const SceneBenchmark& benchmark, const BenchmarkOptions& options)
+{
+	Scene scene;
+	if (!loadSceneByName(benchmark.sceneName, scene))
+	{
+		cerr << benchmark.name << ": couldn't load the " << benchmark.sceneName << " scene" << endl;
+		return false;
+	}
+
+	PinholeCamera camera(benchmark.cameraPosition, benchmark.cameraTarget, benchmark.fov, benchmark.width, benchmark.height);
+
+	RenderSettings settings;
+	settings.numThreads = options.numThreads;
+	Renderer renderer(scene, settings);
+
+	ofPixels pixels;
+	long long bestMilliseconds = std::numeric_limits<long long>::max();
+
+	for (int run = 0; run < max(1, options.renderRuns); run++)
+	{
+		pixels = renderer.render(camera);
+		bestMilliseconds = min(bestMilliseconds, renderer.getStats().milliseconds);
+	}
+
+	const RenderStats& stats = renderer.getStats();
+	uint64_t numRays = stats.primaryRays + stats.shadowRays + stats.reflectionRays;
+
+	cout << "  " << left << setw(40) << benchmark.name << right << setw(8) << bestMilliseconds << " ms"
+		<< setw(10) << fixed << setprecision(2) << numRays / (max(1ll, bestMilliseconds) * 1000.0) << " Mrays/s";
+
+	string referencePath = options.referenceDirectory + "/" + benchmark.name + ".png";
+	ofPixels reference;
+
+	if (!ofLoadImage(reference, referencePath))
+	{
+		//a missing reference fails unless it was asked for, so a wrong directory can't make every check pass without comparing anything
+		if (!options.updateReferences)
+		{
+			cout << "   FAILED: no reference at " << referencePath << " (run with --update-references to save this image as the reference)" << endl;
+			return false;
+		}
+
+		bool saved = ofSaveImage(pixels, referencePath);
+		cout << (saved ? "   no reference, saved this image as " : "   no reference, and couldn't save one to ") << referencePath << endl;
+		return saved;
+	}
+
+	int differentPixels, maxDifference;
+	if (!compareImages(pixels, reference, options.tolerance, differentPixels, maxDifference))
+	{
+		cout << "   FAILED: the reference is " << reference.getWidth() << "x" << reference.getHeight() << endl;
+		return false;
+	}
+
+	bool matches = differentPixels <= options.maxDifferentPixels * benchmark.width * benchmark.height;
+	cout << (matches ? "   matches" : "   FAILED") << " (" << differentPixels << " pixels off by more than " << options.tolerance << ", largest difference " << maxDifference << ")" << endl;
+
+	//keep the image that failed so it can be compared with the reference
+	if (!matches)
+		ofSaveImage(pixels, options.referenceDirectory + "/" + benchmark.name + ".failed.png");
+
+	return matches;
+}
+
+//--------------------------------------------------------------
+
+bool runBenchmarks(const BenchmarkOptions& options)
+{
+	runKernelBenchmarks();
+
+	cout << "Scenes (fastest of " << max(1, options.renderRuns) << " renders):" << endl;
+
+	bool allMatch = true;
+
+	for (const SceneBenchmark& benchmark : getSceneBenchmarks())
+		allMatch = runSceneBenchmark(benchmark, options) && allMatch;
+
+	cout << (allMatch ? "Every image matches its reference" : "Some images don't match their references") << endl;
+
+	return allMatch;
+}
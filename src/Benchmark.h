@@ -0,0 +1,30 @@
+#pragma once
+
+#include "ofMain.h"
+
+/**
+ * Timings for the intersection kernels and for end to end renders of a few fixed scenes, so that optimizations can be measured before they are accepted.
+ * Every render is compared against a reference image, so that an optimization that changes the image fails the benchmark instead of just looking fast.
+ *
+ * Usage: moonlight-raytracer --benchmark references --threads 8
+ * References are PNGs named after each benchmark in the given directory. A benchmark with no reference fails, unless --update-references is given,
+ * in which case it saves its image as the new reference. Delete a reference and run with --update-references to accept a change to its image
+ */
+
+struct BenchmarkOptions
+{
+	string referenceDirectory;
+	int numThreads = 0; //0 means use every hardware thread
+	int renderRuns = 3; //each scene is rendered this many times and the fastest time is reported
+	bool updateReferences = false; //save the image of a benchmark that has no reference as its reference, instead of failing
+
+	//an image matches its reference if no more than maxDifferentPixels (a fraction of the image) of its pixels have a channel that is off by more than tolerance
+	int tolerance = 8;
+	float maxDifferentPixels = .001;
+};
+
+/// <summary>
+/// Runs the kernel benchmarks and then the scene benchmarks, printing the results as it goes. Returns false if any image didn't match its reference
+/// (or a scene or reference couldn't be loaded)
+/// </summary>
+bool runBenchmarks(const BenchmarkOptions& options);
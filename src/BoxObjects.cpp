@@ -2,96 +2,136 @@
 
 //--------------------------------------------------------------
 
-Box::Box(glm::vec3 corner0, glm::vec3 corner1, ofColor color) : SceneObject(color)
+Box::Box(glm::vec3 corner0, glm::vec3 corner1, ofColor color) 
+	: SceneObject(color), minCorner(glm::min(corner0, corner1)), maxCorner(glm::max(corner0, corner1))
+{ }
+
+void Box::draw()
 {
-	float width = corner1[0] - corner0[0];
-	float height = corner0[1] - corner1[1];
-	float depth = corner1[2] - corner0[2];
+	ofSetColor(getDiffuseColor());
+	ofSetLineWidth(1);
+	ofNoFill();
+	ofDrawBox((minCorner + maxCorner) * .5f, maxCorner[0] - minCorner[0], maxCorner[1] - minCorner[1], maxCorner[2] - minCorner[2]);
+}
 
-	sides[0] = Plane(corner0, width, height, Plane::Axis::XY, color);
-	sides[1] = Plane(corner0 + glm::vec3(0, 0, depth), width, height, Plane::Axis::XY, color);
+bool Box::intersectBox(const Ray& ray, float& distance, int& face, glm::vec2& uv) const
+{
+	glm::vec3 t1 = (minCorner - ray.origin) * ray.invDirection;
+	glm::vec3 t2 = (maxCorner - ray.origin) * ray.invDirection;
 
-	sides[2] = Plane(corner0, depth, height, Plane::Axis::YZ, color);
-	sides[3] = Plane(corner0 + glm::vec3(width, 0, 0), depth, height, Plane::Axis::YZ, color);
+	glm::vec3 tSmaller = glm::min(t1, t2);
+	glm::vec3 tBigger = glm::max(t1, t2);
 
-	sides[4] = Plane(corner0, width, depth, Plane::Axis::XZ, color);
-	sides[5] = Plane(corner0 - glm::vec3(0, height, 0), width, depth, Plane::Axis::XZ, color);
-}
+	//the ray is inside every slab between tNear and tFar, and the slabs it entered and left last are the faces it hits
+	int nearAxis = tSmaller[0] > tSmaller[1] ? (tSmaller[0] > tSmaller[2] ? 0 : 2) : (tSmaller[1] > tSmaller[2] ? 1 : 2);
+	int farAxis = tBigger[0] < tBigger[1] ? (tBigger[0] < tBigger[2] ? 0 : 2) : (tBigger[1] < tBigger[2] ? 1 : 2);
 
-void Box::draw()
-{
-	for (Plane p : sides)
-		p.draw();
+	float tNear = tSmaller[nearAxis];
+	float tFar = tBigger[farAxis];
+
+	if (!(tNear <= tFar))
+		return false;
+
+	//a ray that starts inside the box hits the face it leaves through
+	bool leaving = !(tNear > 0);
+	distance = leaving ? tFar : tNear;
+
+	if (!(distance > 0) || distance > ray.maxDistance)
+		return false;
+
+	//entering through a face means moving toward the inside of it, so a ray moving up along an axis enters through the low face and leaves through the high one
+	int axis = leaving ? farAxis : nearAxis;
+	face = axis * 2 + ((ray.direction[axis] > 0) == leaving);
+
+	uv = getFaceUV(face, ray.origin + distance * ray.direction);
+	return true;
 }
 
-bool Box::intersects(const Ray& ray, glm::vec3& intersectPoint, glm::vec3& intersectNormal)
+glm::vec2 Box::getFaceUV(int face, const glm::vec3& point) const
 {
-	float dist2 = std::numeric_limits<float>::infinity();
+	glm::vec3 size = maxCorner - minCorner;
 
-	bool intersectsBox = false;
+	float down = (maxCorner[1] - point[1]) / size[1];
 
-	for (Plane p : sides)
+	switch (getFaceAxis(face))
 	{
-		glm::vec3 tempPoint, tempNormal;
-
-		bool intersectsPlane = p.intersects(ray, tempPoint, tempNormal);
-
-		if (intersectsPlane)
-		{
-			intersectsBox = true;
-			float curDist2 = glm::distance2(tempPoint, ray.origin);
-
-			if (curDist2 < dist2)
-			{
-				intersectPoint = tempPoint;
-				intersectNormal = tempNormal;
-				dist2 = curDist2;
-			}
-		}
+	case 0: return glm::vec2((point[2] - minCorner[2]) / size[2], down);
+	case 1: return glm::vec2((point[0] - minCorner[0]) / size[0], (point[2] - minCorner[2]) / size[2]);
+	default: return glm::vec2((point[0] - minCorner[0]) / size[0], down);
 	}
+}
+
+bool Box::intersects(const Ray& ray, HitRecord& hit)
+{
+	if (!intersectBox(ray, hit.distance, hit.face, hit.uv))
+		return false;
+
+	hit.point = ray.origin + hit.distance * ray.direction;
+
+	//the normal faces back toward the ray, which is out of the box for rays that come from outside of it
+	int axis = getFaceAxis(hit.face);
+	hit.normal = glm::vec3(0);
+	hit.normal[axis] = ray.direction[axis] > 0 ? -1 : 1;
 
-	return intersectsBox;
+	return true;
 }
 
+bool Box::occludes(const Ray& ray)
+{
+	float distance;
+	int face;
+	glm::vec2 uv;
 
-//--------------------------------------------------------------
+	return intersectBox(ray, distance, face, uv);
+}
 
-TexturedBox::TexturedBox(glm::vec3 corner0, glm::vec3 corner1, float maxU, float maxV, shared_ptr<ofImage> texture)
-	: Box(corner0, corner1, ofColor::darkGray), texture(texture), maxU(maxU), maxV(maxV)
+int Box::intersectPacket(const RayPacket& packet, int laneMask, float* distances)
 {
-	float width = corner1[0] - corner0[0];
-	float height = corner0[1] - corner1[1];
-	float depth = corner1[2] - corner0[2];
+	//the same slab test as intersectBox, done for every lane at once. Only the distance is needed here, so the face isn't worked out
+	simd::Floats tNear = simd::set(-std::numeric_limits<float>::infinity());
+	simd::Floats tFar = simd::set(std::numeric_limits<float>::infinity());
 
-	float maxUXZ = maxU;
-	float maxVXZ = maxV;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		simd::Floats rayOrigin = simd::load(packet.origin[axis]);
+		simd::Floats rayInvDirection = simd::load(packet.invDirection[axis]);
 
-	float maxUXY = maxU;
-	float maxVXY = height / depth * maxV;
+		simd::Floats t1 = simd::mul(simd::sub(simd::set(minCorner[axis]), rayOrigin), rayInvDirection);
+		simd::Floats t2 = simd::mul(simd::sub(simd::set(maxCorner[axis]), rayOrigin), rayInvDirection);
 
-	float maxUYZ = maxV;
-	float maxVYZ = height / depth * maxV;
+		tNear = simd::max(tNear, simd::min(t1, t2));
+		tFar = simd::min(tFar, simd::max(t1, t2));
+	}
 
-	sides[0] = TexturedPlane(corner0, width, height, Plane::Axis::XY, maxUXY, maxVXY, texture);
-	sides[1] = TexturedPlane(corner0 + glm::vec3(0, 0, depth), width, height, Plane::Axis::XY, maxUXY, maxVXY, texture);
+	simd::Floats distance = simd::select(simd::greater(tNear, simd::set(0)), tNear, tFar);
 
-	sides[2] = TexturedPlane(corner0, depth, height, Plane::Axis::YZ, maxUYZ, maxVYZ, texture);
-	sides[3] = TexturedPlane(corner0 + glm::vec3(width, 0, 0), depth, height, Plane::Axis::YZ, maxUYZ, maxVYZ, texture);
+	simd::Floats hit = simd::maskAnd(simd::lessEqual(tNear, tFar),
+		simd::maskAnd(simd::greater(distance, simd::set(0)), simd::lessEqual(distance, simd::load(packet.maxDistance))));
 
-	sides[4] = TexturedPlane(corner0, width, depth, Plane::Axis::XZ, maxUXZ, maxVXZ, texture);
-	sides[5] = TexturedPlane(corner0 - glm::vec3(0, height, 0), width, depth, Plane::Axis::XZ, maxUXZ, maxVXZ, texture);
+	simd::store(distances, distance);
+	return simd::moveMask(hit) & laneMask;
 }
 
-ofColor TexturedBox::getDiffuseColor(const glm::vec3& point)
+
+//--------------------------------------------------------------
+
+TexturedBox::TexturedBox(glm::vec3 corner0, glm::vec3 corner1, float maxU, float maxV, shared_ptr<Texture> texture)
+	: Box(corner0, corner1, ofColor::darkGray), texture(texture), maxU(maxU), maxV(maxV)
 {
-	for (int i = 0; i < 6; i++)
-	{
-		TexturedPlane face = sides[i];
+	float height = maxCorner[1] - minCorner[1];
+	float depth = maxCorner[2] - minCorner[2];
 
-		if (face.onInfinitePlane(point))
-		{
-			return face.getDiffuseColor(point);
-		}
-	}
-	return SceneObject::getDiffuseColor();
+	uvScales[0] = glm::vec2(maxV, height / depth * maxV);
+	uvScales[1] = glm::vec2(maxU, maxV);
+	uvScales[2] = glm::vec2(maxU, height / depth * maxV);
+}
+
+ofColor TexturedBox::getDiffuseColor(const HitRecord& hit)
+{
+	if (texture == nullptr)
+		return SceneObject::getDiffuseColor();
+
+	glm::vec2 uv = hit.uv * uvScales[getFaceAxis(hit.face)];
+
+	return texture->sampleColor(uv[0], uv[1]);
 }
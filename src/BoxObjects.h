@@ -5,7 +5,7 @@
 class Box : public SceneObject
 {
 public:
-	Box() {} //default constructor for Box
+	Box() : minCorner(0), maxCorner(0) {} //default constructor for Box
 
 	/**
 	* @param corner0 the far upper left-hand corner
@@ -15,10 +15,33 @@ public:
 
 	virtual void draw();
 
-	virtual bool intersects(const Ray& ray, glm::vec3& intersectPoint, glm::vec3& intersectNormal);
+	virtual bool intersects(const Ray& ray, HitRecord& hit);
+	virtual bool occludes(const Ray& ray);
+	virtual int intersectPacket(const RayPacket& packet, int laneMask, float* distances);
+	virtual AABB getBounds() { return AABB(minCorner, maxCorner); }
+	virtual RenderStats::PrimitiveType getPrimitiveType() { return RenderStats::BOX; }
 
-private:
-	Plane sides[6];
+	//faces are numbered by axis and then side: 0 and 1 are the low and high x faces, 2 and 3 are y, and 4 and 5 are z
+	static int getFaceAxis(int face) { return face / 2; }
+
+	/// <summary>
+	/// Slab test against the box, using the ray's precomputed inverse direction. distance is how far along the ray the hit is, face is the face that was hit
+	/// (which is the one the ray leaves through if it starts inside the box), and uv is where on that face it was hit, from 0 to 1 across the face
+	/// (see getFaceUV)
+	/// </summary>
+	bool intersectBox(const Ray& ray, float& distance, int& face, glm::vec2& uv) const;
+
+	/// <summary>
+	/// Where point is on face, from 0 to 1 across it. u and v run the same way they do on the Planes the box used to be built from:
+	/// x faces have u along z and v down y, y faces have u along x and v along z, and z faces have u along x and v down y
+	/// </summary>
+	glm::vec2 getFaceUV(int face, const glm::vec3& point) const;
+
+	friend class SceneSnapshot; //reads and writes baked scene files
+
+protected:
+	glm::vec3 minCorner;
+	glm::vec3 maxCorner;
 };
 
 class TexturedBox : public Box
@@ -27,13 +50,15 @@ public:
 	TexturedBox() : maxU(0), maxV(0) {} //default constructor for Box
 
 	//maxU and maxV are for the top face; the other faces are scaled off of it
-	TexturedBox(glm::vec3 corner0, glm::vec3 corner1, float maxU, float maxV, shared_ptr<ofImage> texture);
+	TexturedBox(glm::vec3 corner0, glm::vec3 corner1, float maxU, float maxV, shared_ptr<Texture> texture);
 
-	virtual ofColor getDiffuseColor(const glm::vec3& point);
-private:
-	TexturedPlane sides[6];
+	virtual ofColor getDiffuseColor(const HitRecord& hit);
+
+	friend class SceneSnapshot; //reads and writes baked scene files
 
-	shared_ptr<ofImage> texture;
+private:
+	shared_ptr<Texture> texture;
 	float maxU, maxV;
-};
 
+	glm::vec2 uvScales[3]; //how many times the texture repeats across the faces on each axis, worked out from maxU and maxV
+};
@@ -0,0 +1,362 @@
+#include "DistributedRender.h"
+#include "Sequence.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
+
+//--------------------------------------------------------------
+
+namespace
+{
+	//bumped whenever a message changes, so that a worker from another build is turned away instead of misreading it
+	const uint32_t PROTOCOL_VERSION = 1;
+
+	enum class MessageType : uint32_t
+	{
+		HELLO, //worker to coordinator, right after connecting: a Hello
+		ARGUMENTS, //the coordinator's reply: how many arguments there are, then each one's length and characters
+		JOB, //coordinator to worker: a Job to render
+		RESULT, //worker to coordinator: the Job, the RenderStats of rendering it and its RGB pixels, row by row
+		FINISHED //coordinator to worker: there's nothing left to render
+	};
+
+	struct Hello
+	{
+		uint32_t version;
+		uint32_t statsSize; //catches workers built with a different RenderStats layout
+		int32_t numThreads;
+	};
+
+	struct Job
+	{
+		int32_t frame;
+		int32_t x;
+		int32_t y;
+		int32_t width;
+		int32_t height;
+	};
+
+	template<typename T>
+	bool sendValue(Socket& socket, const T& value) { return socket.sendAll(&value, sizeof(T)); }
+
+	template<typename T>
+	bool receiveValue(Socket& socket, T& value) { return socket.receiveAll(&value, sizeof(T)); }
+
+	bool receiveMessageType(Socket& socket, MessageType expected)
+	{
+		MessageType type;
+		return receiveValue(socket, type) && type == expected;
+	}
+}
+
+//--------------------------------------------------------------
+
+//everything the coordinator's threads share, which is only touched while holding lock
+struct CoordinatorState
+{
+	std::mutex lock;
+	std::condition_variable changed; //signaled whenever a job is finished or put back in the queue
+
+	std::deque<Job> pendingJobs;
+	vector<ofPixels> frames; //allocated when the frame's first job is handed out, and freed once it's saved
+	vector<int> jobsLeft; //jobs of each frame that haven't come back yet
+	vector<RenderStats> frameStats;
+	vector<std::chrono::steady_clock::time_point> frameStarts;
+
+	bool finished = false;
+	int numWorkers = 0;
+	int numWorkerThreads = 0;
+};
+
+//copies a finished job into its place in the frame
+static void pasteJob(ofPixels& frame, const Job& job, const vector<unsigned char>& pixels)
+{
+	size_t rowBytes = job.width * 3;
+
+	for (int row = 0; row < job.height; row++)
+		memcpy(frame.getData() + ((size_t)(job.y + row) * frame.getWidth() + job.x) * 3, pixels.data() + row * rowBytes, rowBytes);
+}
+
+/// <summary>
+/// Talks to one worker until every job is done or the worker goes away. A job the worker had when it went away goes back to the front of the queue
+/// </summary>
+static void serveWorker(Socket worker, CoordinatorState& state, const CoordinatorOptions& options)
+{
+	//keepalive notices a machine that's gone, but not a worker that's still connected and stuck, which would otherwise keep its job forever
+	worker.setReceiveTimeout(options.workerTimeout * 1000);
+
+	Hello hello;
+
+	if (!receiveMessageType(worker, MessageType::HELLO) || !receiveValue(worker, hello) || hello.version != PROTOCOL_VERSION || hello.statsSize != sizeof(RenderStats))
+	{
+		cerr << "Turned away a worker that isn't the same build as the coordinator" << endl;
+		return;
+	}
+
+	sendValue(worker, MessageType::ARGUMENTS);
+	sendValue(worker, (uint32_t)options.workerArguments.size());
+
+	for (const string& argument : options.workerArguments)
+	{
+		sendValue(worker, (uint32_t)argument.size());
+		worker.sendAll(argument.data(), argument.size());
+	}
+
+	int numThreads = max(1, (int)hello.numThreads);
+	int workerNumber;
+
+	{
+		std::lock_guard<std::mutex> guard(state.lock);
+		workerNumber = ++state.numWorkers;
+		state.numWorkerThreads += numThreads;
+	}
+
+	cout << "Worker " << workerNumber << " connected with " << numThreads << " threads" << endl;
+
+	vector<unsigned char> pixels;
+
+	while (true)
+	{
+		Job job;
+
+		{
+			std::unique_lock<std::mutex> guard(state.lock);
+			state.changed.wait(guard, [&]() { return state.finished || !state.pendingJobs.empty(); });
+
+			if (state.pendingJobs.empty())
+				break;
+
+			job = state.pendingJobs.front();
+			state.pendingJobs.pop_front();
+
+			if (!state.frames[job.frame].isAllocated())
+			{
+				state.frames[job.frame].allocate(options.width, options.height, OF_IMAGE_COLOR);
+				state.frameStarts[job.frame] = std::chrono::steady_clock::now();
+			}
+		}
+
+		RenderStats stats;
+		pixels.resize((size_t)job.width * job.height * 3);
+		Job finishedJob;
+
+		bool succeeded = sendValue(worker, MessageType::JOB) && sendValue(worker, job)
+			&& receiveMessageType(worker, MessageType::RESULT) && receiveValue(worker, finishedJob) && receiveValue(worker, stats)
+			&& memcmp(&finishedJob, &job, sizeof(Job)) == 0 && worker.receiveAll(pixels.data(), pixels.size());
+
+		std::lock_guard<std::mutex> guard(state.lock);
+
+		if (!succeeded)
+		{
+			//the job is handed to the next worker that asks, before any new ones
+			state.pendingJobs.push_front(job);
+			state.numWorkerThreads -= numThreads;
+			state.changed.notify_all();
+
+			cerr << "Worker " << workerNumber << " disconnected or stopped responding; its job at " << job.x << "," << job.y << " of frame " << job.frame << " will be rendered again" << endl;
+			return;
+		}
+
+		pasteJob(state.frames[job.frame], job, pixels);
+		state.frameStats[job.frame].merge(stats);
+
+		if (--state.jobsLeft[job.frame] == 0)
+			state.changed.notify_all();
+	}
+
+	sendValue(worker, MessageType::FINISHED);
+
+	std::lock_guard<std::mutex> guard(state.lock);
+	state.numWorkerThreads -= numThreads;
+}
+
+bool runTileCoordinator(const CoordinatorOptions& options)
+{
+	Socket listener;
+
+	if (!listener.listen(options.port))
+	{
+		cerr << "Couldn't listen for workers on port " << options.port << endl;
+		return false;
+	}
+
+	//jobs are made of whole tiles, so that they're rendered exactly like they would be in a single process
+	int jobSize = max(1, (options.jobSize + options.tileSize - 1) / options.tileSize) * options.tileSize;
+
+	CoordinatorState state;
+	state.frames.resize(options.numFrames);
+	state.jobsLeft.resize(options.numFrames, 0);
+	state.frameStats.resize(options.numFrames);
+	state.frameStarts.resize(options.numFrames);
+
+	for (int frame = 0; frame < options.numFrames; frame++)
+	{
+		for (int y = 0; y < options.height; y += jobSize)
+		{
+			for (int x = 0; x < options.width; x += jobSize)
+			{
+				state.pendingJobs.push_back({ frame, x, y, min(jobSize, options.width - x), min(jobSize, options.height - y) });
+				state.jobsLeft[frame]++;
+			}
+		}
+	}
+
+	cout << "Waiting for workers on port " << options.port << " to render " << state.pendingJobs.size() << " jobs of " << jobSize << "x" << jobSize << " pixels" << endl;
+
+	vector<std::thread> workerThreads;
+
+	//the timeout lets this thread notice when everything is done
+	std::thread acceptThread([&]()
+	{
+		while (true)
+		{
+			{
+				std::lock_guard<std::mutex> guard(state.lock);
+				if (state.finished)
+					return;
+			}
+
+			Socket worker;
+			if (listener.accept(worker, 250))
+				workerThreads.emplace_back(serveWorker, std::move(worker), std::ref(state), std::cref(options));
+		}
+	});
+
+	bool allSaved = true;
+
+	//frames are saved in order as they finish, while the workers carry on with the frames after them
+	for (int frame = 0; frame < options.numFrames; frame++)
+	{
+		ofPixels pixels;
+		RenderStats stats;
+
+		{
+			std::unique_lock<std::mutex> guard(state.lock);
+			state.changed.wait(guard, [&]() { return state.jobsLeft[frame] == 0; });
+
+			pixels = std::move(state.frames[frame]);
+			state.frames[frame] = ofPixels();
+
+			stats = state.frameStats[frame];
+			stats.numThreads = state.numWorkerThreads;
+			stats.width = options.width;
+			stats.height = options.height;
+			stats.milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - state.frameStarts[frame]).count();
+		}
+
+		string path = options.numFrames > 1 ? getFramePath(options.outputPath, frame) : options.outputPath;
+
+		if (ofSaveImage(pixels, path))
+			cout << "Frame " << frame + 1 << " of " << options.numFrames << " took " << stats.milliseconds << " ms, saved to " << path << endl;
+		else
+		{
+			cerr << "Couldn't save frame to " << path << endl;
+			allSaved = false;
+		}
+
+		stats.saveJson(RenderStats::pathForImage(path));
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(state.lock);
+		state.finished = true;
+		state.changed.notify_all();
+	}
+
+	//only the accept thread adds worker threads, so once it's done the list can be joined safely
+	acceptThread.join();
+
+	for (std::thread& thread : workerThreads)
+		thread.join();
+
+	return allSaved;
+}
+
+//--------------------------------------------------------------
+
+bool connectToCoordinator(const string& address, int numThreads, Socket& coordinator, vector<string>& arguments)
+{
+	size_t colon = address.find_last_of(':');
+	int port = colon == string::npos ? 0 : ofToInt(address.substr(colon + 1));
+
+	if (port <= 0)
+	{
+		cerr << "The coordinator's address has to be HOST:PORT, got " << address << endl;
+		return false;
+	}
+
+	if (!coordinator.connect(address.substr(0, colon), port))
+	{
+		cerr << "Couldn't connect to the coordinator at " << address << endl;
+		return false;
+	}
+
+	Hello hello = { PROTOCOL_VERSION, (uint32_t)sizeof(RenderStats), numThreads };
+	uint32_t numArguments;
+
+	if (!sendValue(coordinator, MessageType::HELLO) || !sendValue(coordinator, hello)
+		|| !receiveMessageType(coordinator, MessageType::ARGUMENTS) || !receiveValue(coordinator, numArguments))
+	{
+		cerr << "The coordinator at " << address << " turned this worker away; it has to be the same build" << endl;
+		return false;
+	}
+
+	arguments.clear();
+
+	for (uint32_t i = 0; i < numArguments; i++)
+	{
+		uint32_t length;
+		if (!receiveValue(coordinator, length))
+			return false;
+
+		string argument(length, '\0');
+		if (!coordinator.receiveAll(&argument[0], length))
+			return false;
+
+		arguments.push_back(argument);
+	}
+
+	return true;
+}
+
+bool runTileWorker(Socket& coordinator, Scene& scene, const RenderSettings& settings, const std::function<PinholeCamera(int)>& prepareFrame)
+{
+	Renderer renderer(scene, settings);
+	PinholeCamera camera;
+	int currentFrame = -1;
+	int jobsDone = 0;
+
+	while (true)
+	{
+		MessageType type;
+		Job job;
+
+		if (!receiveValue(coordinator, type) || (type != MessageType::JOB && type != MessageType::FINISHED))
+			return false;
+
+		if (type == MessageType::FINISHED)
+			break;
+
+		if (!receiveValue(coordinator, job))
+			return false;
+
+		if (job.frame != currentFrame)
+		{
+			camera = prepareFrame(job.frame);
+			currentFrame = job.frame;
+		}
+
+		ofPixels pixels = renderer.renderRegion(camera, Tile(job.x, job.y, job.width, job.height));
+
+		if (!sendValue(coordinator, MessageType::RESULT) || !sendValue(coordinator, job) || !sendValue(coordinator, renderer.getStats())
+			|| !coordinator.sendAll(pixels.getData(), pixels.getTotalBytes()))
+			return false;
+
+		jobsDone++;
+	}
+
+	cout << "The coordinator is done; this worker rendered " << jobsDone << " jobs" << endl;
+	return true;
+}
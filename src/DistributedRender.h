@@ -0,0 +1,54 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Scene.h"
+#include "Renderer.h"
+#include "Socket.h"
+#include <functional>
+
+/**
+ * Spreads a render (or every frame of a sequence) over worker processes, which can be on any machine that can reach the coordinator.
+ * The coordinator splits each frame into square jobs and hands them out one at a time as workers ask for them, so faster machines simply take more of them;
+ * a job whose worker disconnects, or sends nothing for workerTimeout seconds, goes back into the queue. Finished jobs are stitched into their frame, which is saved as soon as its last job comes back.
+ *
+ * Usage: moonlight-raytracer --scene moon --width 7680 --height 4320 --output moon.png --listen 5000
+ *        moonlight-raytracer --worker coordinator-host:5000 --threads 32   (once on every machine)
+ * Workers are sent the coordinator's command line and set themselves up from it, so any scene, snapshot or sequence file it names has to be at the same path
+ * on every worker. Messages use the machine's native byte order and struct layout, so like snapshots, the workers have to be the same build as the coordinator.
+ * Jobs start on multiples of the render tile size, so the stitched image is exactly the one a single process would render (except with the irradiance cache on,
+ * which each worker fills in on its own)
+ */
+
+struct CoordinatorOptions
+{
+	int port = 0;
+	int jobSize = 256; //the width and height of the jobs, in pixels (rounded up to a multiple of the tile size)
+	int workerTimeout = 600; //seconds a worker can go without sending anything before it's dropped, so it has to be longer than the slowest job takes
+
+	string outputPath; //like a sequence, frames get their number added to this when there is more than one
+	int numFrames = 1;
+	int width = 0;
+	int height = 0;
+	int tileSize = 32;
+
+	vector<string> workerArguments; //the command line the workers set themselves up from
+};
+
+/// <summary>
+/// Waits for workers on options.port and hands out the jobs of every frame until all of them are done and saved. Returns false if the port can't be listened on
+/// or a frame couldn't be saved
+/// </summary>
+bool runTileCoordinator(const CoordinatorOptions& options);
+
+/// <summary>
+/// Connects to the coordinator at address (HOST:PORT), telling it how many threads this worker renders with (which only goes into the statistics), and gets the command line it was started with, which the worker sets its scene up from.
+/// Returns false (after printing why) if it can't connect or the coordinator isn't the same build
+/// </summary>
+bool connectToCoordinator(const string& address, int numThreads, Socket& coordinator, vector<string>& arguments);
+
+/// <summary>
+/// Renders the jobs the coordinator hands out until it says every frame is done. prepareFrame(frame) is called before the first job of each frame
+/// a worker gets, and has to set the scene up for that frame (moving and refitting its objects, for sequences) and return the frame's camera.
+/// Returns false if the connection is lost before the coordinator finishes
+/// </summary>
+bool runTileWorker(Socket& coordinator, Scene& scene, const RenderSettings& settings, const std::function<PinholeCamera(int)>& prepareFrame);
@@ -1,4 +1,5 @@
 #include "GraphicalStructs.h"
+#include "ObjLoader.h"
 #include <fstream>
 #include <iostream>
 #include <cstdlib>
@@ -21,59 +22,11 @@ void Mesh::draw()
 
 istream& operator>>(istream& ins, Mesh& m)
 {
-	char ch, test_ch;
+	//read the rest of the stream into memory and hand it to the same parser loadObj uses
+	string contents((istreambuf_iterator<char>(ins)), istreambuf_iterator<char>());
 
-	ins >> ch >> test_ch;
-
-	while (ch != 'v') //skip any comments/whitespace until the vertex list
-	{
-		if (ch == '#') //skip the line if it is a comment
-		{
-			ins.ignore(numeric_limits<streamsize>::max(), '\n');
-		}
-
-		ins >> ch; //keep consuming characters until the vertex list
-
-	}
-
-	while (ch == 'v' && ins.get() == ' ') //handles adding vertices
-	{
-		float x, y, z;
-
-		ins >> x >> y >> z;
-		ins >> ch;
-
-		m.verts.push_back(glm::vec3(x, y, z));
-	}
-
-	while (ch != 'f') //skips any comments/whitespace until the face list
-	{
-		if (ch == '#') //skip the line if it is a comment
-		{
-			ins.ignore(numeric_limits<streamsize>::max(), '\n');
-		}
-
-		ins >> ch; //ignores everything else until the face list
-	}
-
-	while (ch == 'f' && !ins.eof()) //handles adding faces
-	{
-		string token; //this is used to read in a tokenized part of the face, which may look like v1/vt1/vn1, but we only want v1
-		int v1, v2, v3;
-
-		ins >> token;
-		v1 = stoi(token) - 1; //stoi extracts the first integer from a string, but stops when it reaches the first non-digit character so we only get v1
-
-		ins >> token;
-		v2 = stoi(token) - 1; //vertex numbers start from 1, but vector idices start from 0, hence the -1
-
-		ins >> token;
-		v3 = stoi(token) - 1;
-
-		ins >> ch; //consumes the next f character
-
-		m.triangles.push_back(Tri(v1, v2, v3));
-	}
+	if (!parseObj(contents.data(), contents.data() + contents.size(), m))
+		ins.setstate(ios::failbit);
 
 	return ins;
 }
@@ -82,12 +35,34 @@ ostream& operator<<(ostream& os, Mesh& m)
 {
 	os << "This mesh has " << m.verts.size() << " vertices.\n";
 	os << "This mesh has " << m.triangles.size() << " faces.\n";
-	os << "This mesh is " << (sizeof(glm::vec3) * m.verts.size() + sizeof(Tri) * m.triangles.size()) / 1024.0 << " kilobytes." << endl; //can't use sizeof for Mesh because it doesn't work well with vectors
+	os << "This mesh is " << (sizeof(glm::vec3) * (m.verts.size() + m.normals.size()) + sizeof(glm::vec2) * m.uvs.size()
+		+ sizeof(Tri) * (m.triangles.size() + m.uvTriangles.size() + m.normalTriangles.size())) / 1024.0 << " kilobytes." << endl; //can't use sizeof for Mesh because it doesn't work well with vectors
 
 	return os;
 }
 
 
+//--------------------------------------------------------------
+
+PinholeCamera::PinholeCamera(const ofCamera& cam, int width, int height)
+	: PinholeCamera(cam.getGlobalPosition(), cam.getGlobalPosition() + cam.getLookAtDir(), cam.getFov(), width, height, cam.getUpDir())
+{
+
+}
+
+PinholeCamera::PinholeCamera(glm::vec3 position, glm::vec3 lookAt, float fov, int width, int height, glm::vec3 up) : position(position), width(width), height(height)
+{
+	//fov is the vertical field of view in degrees, just like ofCamera
+	float halfHeight = tan(glm::radians(fov) / 2);
+	float halfWidth = halfHeight * width / height;
+
+	forward = glm::normalize(lookAt - position);
+	glm::vec3 side = glm::normalize(glm::cross(forward, up));
+
+	right = side * halfWidth;
+	this->up = glm::cross(side, forward) * halfHeight;
+}
+
 //--------------------------------------------------------------
 
 glm::vec3 Light::lightAt(glm::vec3 point)
@@ -102,7 +77,8 @@ glm::vec3 Light::lightAt(glm::vec3 point)
 
 //--------------------------------------------------------------
 
-Spotlight::Spotlight(glm::vec3 origin, float luminosity, glm::vec3 direction, float coneAngle) : Light(origin, luminosity), direction(direction), coneAngle(coneAngle)
+Spotlight::Spotlight(glm::vec3 origin, float luminosity, glm::vec3 direction, float coneAngle) : Light(origin, luminosity), direction(direction), coneAngle(coneAngle),
+	cosHalfAngle(cos(coneAngle / 2))
 {
 
 }
@@ -131,14 +107,51 @@ void Spotlight::draw()
 
 glm::vec3 Spotlight::lightAt(glm::vec3 point)
 {
-	glm::vec3 vecToPoint = glm::normalize(point - getOrigin());
-
-	float angle = acos(glm::dot(direction, vecToPoint));
-
-	if (angle <= coneAngle / 2) //if the point is within the cone defined by the direction and cone angle
+	if (isInCone(point)) //if the point is within the cone defined by the direction and cone angle
 		return Light::lightAt(point);
 
 	else
 		return glm::vec3(0, 0, 0);
 
+}
+
+bool Spotlight::canLight(const glm::vec3& point)
+{
+	return Light::canLight(point) && isInCone(point);
+}
+
+AABB Spotlight::getBounds()
+{
+	//a cone wider than a half sphere reaches about as far as a plain light
+	if (coneAngle / 2 >= M_PI / 2)
+		return Light::getBounds();
+
+	//otherwise the cone is inside the box around its tip, the circle where its sides end, and the cap that rounds off its end
+	glm::vec3 origin = getOrigin();
+	float range = getRange();
+	glm::vec3 circleCenter = origin + direction * range * cosHalfAngle;
+	float circleRadius = range * sin(coneAngle / 2);
+
+	//how far a circle facing along direction sticks out along each axis
+	glm::vec3 circleExtent = circleRadius * glm::sqrt(glm::max(glm::vec3(0), glm::vec3(1) - direction * direction));
+
+	AABB bounds;
+	bounds.grow(origin);
+	bounds.grow(AABB(circleCenter - circleExtent, circleCenter + circleExtent));
+	bounds.grow(origin + direction * range);
+
+	//the cap sticks out furthest along an axis at the axis itself, if the axis is inside the cone, rather than at the circle or along direction
+	for (int axis = 0; axis < 3; axis++)
+	{
+		for (float sign : { -1.f, 1.f })
+		{
+			glm::vec3 axisDirection(0);
+			axisDirection[axis] = sign;
+
+			if (glm::dot(direction, axisDirection) >= cosHalfAngle)
+				bounds.grow(origin + range * axisDirection);
+		}
+	}
+
+	return bounds;
 }
\ No newline at end of file
@@ -23,6 +23,13 @@ struct Mesh
 	vector<glm::vec3> verts;
 	vector<Tri> triangles;
 
+	//optional texture coordinates and normals. When a mesh has them, uvTriangles and normalTriangles have one entry per triangle
+	//holding the indices into uvs and normals for that triangle's corners (-1 if a corner doesn't have one)
+	vector<glm::vec2> uvs;
+	vector<glm::vec3> normals;
+	vector<Tri> uvTriangles;
+	vector<Tri> normalTriangles;
+
 	void draw();
 	friend istream& operator >>(std::istream& ins, Mesh& m);
 	friend ostream& operator <<(std::ostream& os, Mesh& m);
@@ -31,26 +38,116 @@ struct Mesh
 //Mainly a wrapper for the origin and direction vectors, but also contains info needed to make sure that shadows are being calculated correctly
 struct Ray
 {
-	Ray(glm::vec3 origin, glm::vec3 direction, float maxDistance = std::numeric_limits<float>::infinity()) : origin(origin), direction(direction), maxDistance(maxDistance)
-	{
-		/* used by box intersection (no longer implemented)
-		inv_direction = glm::vec3(1 / origin[0], 1 / origin[1], 1 / origin[2]);
-		sign[0] = inv_direction[0] < 0;
-		sign[1] = inv_direction[1] < 0;
-		sign[2] = inv_direction[2] < 0;
-		*/
-	}
+	Ray(glm::vec3 origin, glm::vec3 direction, float maxDistance = std::numeric_limits<float>::infinity()) 
+		: origin(origin), direction(direction), invDirection(1.0f / direction), maxDistance(maxDistance) {}
 
 	glm::vec3 origin;
 	glm::vec3 direction;
+	glm::vec3 invDirection; //1 / direction, for slab tests against boxes (see AABB::intersects)
 	float maxDistance;
 };
 
+/// <summary>
+/// Everything an intersection test finds out about a hit, filled in once by the object that was hit and then handed to shading as is,
+/// so that nothing about the hit has to be worked out again
+/// </summary>
+struct HitRecord
+{
+	HitRecord() : distance(std::numeric_limits<float>::infinity()), uv(0), face(0), objectIndex(-1) {}
+
+	float distance; //from the ray's origin to point
+	glm::vec3 point;
+	glm::vec3 normal; //faces back toward the ray's origin, and already includes things like normal maps
+
+	glm::vec2 uv; //where on the object the hit is, for objects that have texture coordinates (see each object's parameterizePoint)
+	int face; //which face was hit, for objects that have more than one (see Box)
+	int objectIndex; //the index of the object in the scene, filled in by Scene and BVH rather than by the object itself (-1 if nothing was hit)
+};
+
+//axis-aligned bounding box, used by the BVH and by objects that want a cheap early-out test
+struct AABB
+{
+	AABB() : minCorner(std::numeric_limits<float>::infinity()), maxCorner(-std::numeric_limits<float>::infinity()) {} //an empty box; growing it by anything gives that thing's bounds
+	AABB(glm::vec3 minCorner, glm::vec3 maxCorner) : minCorner(minCorner), maxCorner(maxCorner) {}
+
+	void grow(const glm::vec3& point) { minCorner = glm::min(minCorner, point); maxCorner = glm::max(maxCorner, point); }
+	void grow(const AABB& box) { minCorner = glm::min(minCorner, box.minCorner); maxCorner = glm::max(maxCorner, box.maxCorner); }
+	void pad(float amount) { minCorner -= glm::vec3(amount); maxCorner += glm::vec3(amount); }
+
+	bool isEmpty() const { return minCorner.x > maxCorner.x || minCorner.y > maxCorner.y || minCorner.z > maxCorner.z; }
+	bool contains(const glm::vec3& point) const
+	{
+		return point.x >= minCorner.x && point.y >= minCorner.y && point.z >= minCorner.z && point.x <= maxCorner.x && point.y <= maxCorner.y && point.z <= maxCorner.z;
+	}
+	glm::vec3 getCenter() const { return (minCorner + maxCorner) * .5f; }
+
+	float getSurfaceArea() const
+	{
+		if (isEmpty())
+			return 0;
+
+		glm::vec3 size = maxCorner - minCorner;
+		return 2 * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	/// <summary>
+	/// Slab test against the box. invDirection is 1 / ray.direction (Ray::invDirection), which is worked out once per ray instead of once per box.
+	/// tEntry is set to the distance along the ray where it enters the box (which is negative if the ray starts inside the box)
+	/// </summary>
+	bool intersects(const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance, float& tEntry) const
+	{
+		glm::vec3 t1 = (minCorner - origin) * invDirection;
+		glm::vec3 t2 = (maxCorner - origin) * invDirection;
+
+		glm::vec3 tSmaller = glm::min(t1, t2);
+		glm::vec3 tBigger = glm::max(t1, t2);
+
+		float tNear = max(max(tSmaller.x, tSmaller.y), tSmaller.z);
+		float tFar = min(min(tBigger.x, tBigger.y), tBigger.z);
+
+		tEntry = tNear;
+		return tNear <= tFar && tFar >= 0 && tNear <= maxDistance;
+	}
+
+	glm::vec3 minCorner;
+	glm::vec3 maxCorner;
+};
+
+/// <summary>
+/// A plain copy of the parts of an ofCamera needed to generate primary rays. 
+/// ofCamera::screenToWorld inverts the projection matrix on every call and reads the current GL viewport, so it can't be shared between render threads
+/// </summary>
+struct PinholeCamera
+{
+	PinholeCamera() : width(0), height(0) {}
+	PinholeCamera(const ofCamera& cam, int width, int height);
+	PinholeCamera(glm::vec3 position, glm::vec3 lookAt, float fov, int width, int height, glm::vec3 up = glm::vec3(0, 1, 0));
+
+	/// <summary>
+	/// Gets the ray from the camera through the screen position (x, y), where (0, 0) is the upper left corner of the image
+	/// </summary>
+	Ray getRay(float x, float y) const
+	{
+		//same mapping as ofCamera::screenToWorld: x goes from -1 to 1 left to right and y goes from 1 to -1 top to bottom
+		float ndcX = 2 * x / width - 1;
+		float ndcY = 1 - 2 * y / height;
+
+		return Ray(position, glm::normalize(forward + ndcX * right + ndcY * up));
+	}
+
+	glm::vec3 position;
+	glm::vec3 forward;
+	glm::vec3 right; //scaled by the horizontal half-extent of the image plane
+	glm::vec3 up; //scaled by the vertical half-extent of the image plane
+	int width;
+	int height;
+};
+
 //classes
 class Light 
 {
 public:
-	Light(glm::vec3 origin, float luminosity) : origin(origin), luminosity(luminosity) {}
+	Light(glm::vec3 origin, float luminosity) : origin(origin), luminosity(luminosity), range(sqrt(max(0.f, luminosity) / MIN_INTENSITY)) {}
 	virtual void draw() { ofSetColor(ofColor::white); ofDrawSphere(origin, LIGHT_RADIUS); }
 	virtual glm::vec3 lightAt(glm::vec3 point);
 	Ray getRayToLight(glm::vec3 point) 
@@ -59,13 +156,30 @@ public:
 		return Ray(point, (origin - point) / distance, distance); 
 	}
 
+	/// <summary>
+	/// Cheap test of whether the light adds anything at the point, done before a shadow ray is traced to it. A plain light only checks that the point
+	/// is within its range; spotlights also check that it is inside their cone
+	/// </summary>
+	virtual bool canLight(const glm::vec3& point) { return glm::distance2(point, origin) <= range * range; }
+
+	//a box around everything canLight can be true for, which is what the scene's light tree is built from
+	virtual AABB getBounds() { return AABB(origin - glm::vec3(range), origin + glm::vec3(range)); }
+
 	glm::vec3 getOrigin() { return origin; }
+	float getLuminosity() { return luminosity; }
+	float getRange() { return range; }
+
+	friend class SceneSnapshot; //reads and writes baked scene files
 
 private:
 	const float LIGHT_RADIUS = 1;
 
+	//the intensity (luminosity / distance^2) below which a light can't change a color channel by a whole step, which is where its range ends
+	static constexpr float MIN_INTENSITY = 1 / 512.0f;
+
 	glm::vec3 origin;
 	float luminosity;
+	float range;
 };
 
 
@@ -76,6 +190,13 @@ public:
 
 	virtual void draw();
 	virtual glm::vec3 lightAt(glm::vec3 point);
+	virtual bool canLight(const glm::vec3& point);
+	virtual AABB getBounds();
+
+	glm::vec3 getDirection() { return direction; }
+	float getConeAngle() { return coneAngle; }
+
+	friend class SceneSnapshot; //reads and writes baked scene files
 
 private:
 	const float LIGHT_LENGTH = 1;
@@ -83,6 +204,14 @@ private:
 
 	glm::vec3 direction;
 	float coneAngle;
+	float cosHalfAngle; //cos(coneAngle / 2), so that the cone test is a dot product rather than an acos per point
+
+	bool isInCone(const glm::vec3& point)
+	{
+		//the same as comparing the angle to coneAngle / 2, without normalizing the vector to the point
+		glm::vec3 vecToPoint = point - getOrigin();
+		return glm::dot(direction, vecToPoint) >= cosHalfAngle * glm::length(vecToPoint);
+	}
 };
 
 
@@ -0,0 +1,73 @@
+#include "InstanceObjects.h"
+
+//--------------------------------------------------------------
+
+Instance::Instance(shared_ptr<SceneObject> object, const glm::mat4& objectToWorld) : object(object)
+{
+	setTransform(objectToWorld);
+}
+
+void Instance::setTransform(const glm::mat4& objectToWorld)
+{
+	this->objectToWorld = objectToWorld;
+	worldToObject = glm::inverse(objectToWorld);
+	normalToWorld = glm::transpose(glm::inverse(glm::mat3(objectToWorld)));
+}
+
+void Instance::draw()
+{
+	ofPushMatrix();
+	ofMultMatrix(objectToWorld);
+	object->draw();
+	ofPopMatrix();
+}
+
+Ray Instance::toObjectSpace(const Ray& ray, float& scale) const
+{
+	glm::vec3 origin = glm::vec3(worldToObject * glm::vec4(ray.origin, 1));
+	glm::vec3 direction = glm::vec3(worldToObject * glm::vec4(ray.direction, 0));
+
+	scale = glm::length(direction);
+
+	return Ray(origin, direction / scale, ray.maxDistance * scale);
+}
+
+bool Instance::intersects(const Ray& ray, HitRecord& hit)
+{
+	float scale;
+	if (!object->intersects(toObjectSpace(ray, scale), hit))
+		return false;
+
+	//uv and face are already right, since they are measured on the object
+	hit.distance /= scale;
+	hit.point = ray.origin + hit.distance * ray.direction;
+	hit.normal = glm::normalize(normalToWorld * hit.normal);
+	return true;
+}
+
+bool Instance::occludes(const Ray& ray)
+{
+	float scale;
+	return object->occludes(toObjectSpace(ray, scale));
+}
+
+AABB Instance::getBounds()
+{
+	AABB objectBounds = object->getBounds();
+	AABB bounds;
+
+	if (objectBounds.isEmpty())
+		return bounds;
+
+	//the bounds of the transformed corners, which contain everything inside the transformed box
+	for (int corner = 0; corner < 8; corner++)
+	{
+		glm::vec3 point((corner & 1) ? objectBounds.maxCorner.x : objectBounds.minCorner.x,
+			(corner & 2) ? objectBounds.maxCorner.y : objectBounds.minCorner.y,
+			(corner & 4) ? objectBounds.maxCorner.z : objectBounds.minCorner.z);
+
+		bounds.grow(glm::vec3(objectToWorld * glm::vec4(point, 1)));
+	}
+
+	return bounds;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "SceneObjects.h"
+
+/// <summary>
+/// A copy of another object placed somewhere else in the scene by a transform (any mix of translation, rotation and scale).
+/// The object itself is shared by every instance of it and is never changed, so a scene can reuse the same geometry (and its textures and heightfields)
+/// thousands of times while only paying for a matrix per copy. Rays are moved into the object's space and intersected there, and the hit is moved back
+/// </summary>
+class Instance : public SceneObject
+{
+public:
+	Instance() : objectToWorld(1), worldToObject(1), normalToWorld(glm::vec3(1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, 0, 1)) {} //default constructor for Instance
+
+	/**
+	* @param object the shared geometry, in its own space. It shouldn't be changed once any instance of it is in a scene
+	* @param objectToWorld where this copy of it goes
+	*/
+	Instance(shared_ptr<SceneObject> object, const glm::mat4& objectToWorld);
+
+	virtual void draw();
+
+	virtual bool intersects(const Ray& ray, HitRecord& hit);
+	virtual bool occludes(const Ray& ray);
+	virtual AABB getBounds();
+	virtual RenderStats::PrimitiveType getPrimitiveType() { return RenderStats::INSTANCE; }
+
+	//the colors and materials are the shared object's; textured objects look them up with the hit's uv and face, which don't change with the transform
+	virtual ofColor getDiffuseColor() { return object->getDiffuseColor(); }
+	virtual ofColor getDiffuseColor(const HitRecord& hit) { return object->getDiffuseColor(hit); }
+
+	virtual ofColor getSpectralColor() { return object->getSpectralColor(); }
+	virtual ofColor getSpectralColor(const HitRecord& hit) { return object->getSpectralColor(hit); }
+
+	virtual bool isReflective() { return object->isReflective(); }
+	virtual float getReflectance() { return object->getReflectance(); }
+
+	virtual bool isTransparent() { return object->isTransparent(); }
+
+	const shared_ptr<SceneObject>& getObject() const { return object; }
+	const glm::mat4& getTransform() const { return objectToWorld; }
+
+	/// <summary>
+	/// Moves this copy of the object. If the instance is already in a finalized scene, the scene has to be refit (see Scene::refit) before rays are traced again
+	/// </summary>
+	void setTransform(const glm::mat4& objectToWorld);
+
+	friend class SceneSnapshot; //reads and writes baked scene files
+
+private:
+	shared_ptr<SceneObject> object;
+
+	glm::mat4 objectToWorld;
+	glm::mat4 worldToObject;
+	glm::mat3 normalToWorld; //the inverse transpose of objectToWorld's upper 3x3, which keeps normals perpendicular to surfaces under non-uniform scales
+
+	/// <summary>
+	/// Moves the ray into the object's space. Its direction is normalized again there (so the object's intersection tests work as usual),
+	/// which scales distances along it by scale: a distance in the object's space is scale times the same distance in the world
+	/// </summary>
+	Ray toObjectSpace(const Ray& ray, float& scale) const;
+};
@@ -0,0 +1,112 @@
+#include "IrradianceCache.h"
+
+//--------------------------------------------------------------
+
+float IrradianceCache::getRadius(const HitRecord& hit) const
+{
+	return glm::clamp(spacing * hit.distance, ldexp(1.f, MIN_LEVEL), ldexp(1.f, MAX_LEVEL));
+}
+
+int IrradianceCache::getLevel(float radius)
+{
+	//the smallest cells that are at least as big as the radius, so a sample never overlaps more than two of them along any axis
+	return ceil(log2(radius));
+}
+
+glm::ivec3 IrradianceCache::getCell(const glm::vec3& point, int level)
+{
+	return glm::ivec3(glm::floor(point / ldexp(1.f, level)));
+}
+
+uint64_t IrradianceCache::getCellKey(const glm::ivec3& cell, int level)
+{
+	//19 bits for each axis and the rest for the level. Cells far enough apart to wrap around are far enough apart that nothing in them is ever compared
+	const uint64_t mask = (1 << 19) - 1;
+	return ((uint64_t)cell.x & mask) | (((uint64_t)cell.y & mask) << 19) | (((uint64_t)cell.z & mask) << 38) | ((uint64_t)(level - MIN_LEVEL) << 57);
+}
+
+bool IrradianceCache::find(const HitRecord& hit, glm::vec3& irradiance, int& numNearby) const
+{
+	numNearby = 0;
+
+	//only samples in the same grid as one taken here would be are looked at. The others were taken from much closer or much farther away,
+	//and looking for them would mean looking in every grid
+	float radius = getRadius(hit);
+	int level = getLevel(radius);
+
+	//a sample is in every cell its reach overlaps, so the point's own cell has every sample that reaches it
+	uint64_t key = getCellKey(getCell(hit.point, level), level);
+	const Shard& shard = getShard(key);
+	std::shared_lock<std::shared_mutex> lock(shard.mutex);
+
+	auto cell = shard.cells.find(key);
+	if (cell == shard.cells.end())
+		return false;
+
+	glm::vec3 weightedSum(0);
+	glm::vec3 weightedOffset(0);
+	float totalWeight = 0;
+	float minShading = std::numeric_limits<float>::infinity();
+	float maxShading = -std::numeric_limits<float>::infinity();
+
+	for (const Sample& sample : cell->second)
+	{
+		if (sample.objectIndex != hit.objectIndex || sample.face != hit.face)
+			continue;
+
+		float distance = glm::distance(sample.point, hit.point);
+		if (distance >= sample.radius)
+			continue;
+
+		//closer samples count for more, fading to nothing at the edge of their reach
+		float weight = 1 - distance / sample.radius;
+		weightedSum += weight * sample.irradiance;
+		weightedOffset += weight * (sample.point - hit.point);
+		totalWeight += weight;
+		numNearby++;
+
+		//what each sample would shade this point as, which is what has to agree
+		float shading = max(0.f, glm::dot(sample.irradiance, hit.normal));
+		minShading = min(minShading, shading);
+		maxShading = max(maxShading, shading);
+	}
+
+	if (numNearby < MIN_SAMPLES || maxShading - minShading > maxError)
+		return false;
+
+	//if the samples are all off to one side, the point could be past the edge of a shadow that none of them are in, so it isn't extrapolated to
+	if (glm::length(weightedOffset / totalWeight) > radius / 2)
+		return false;
+
+	irradiance = weightedSum / totalWeight;
+	return true;
+}
+
+void IrradianceCache::add(const HitRecord& hit, const glm::vec3& irradiance, int numNearby)
+{
+	if (numNearby >= MAX_SAMPLES)
+		return;
+
+	float radius = getRadius(hit);
+	int level = getLevel(radius);
+	Sample sample = { hit.point, irradiance, radius, hit.objectIndex, hit.face };
+
+	glm::ivec3 firstCell = getCell(hit.point - glm::vec3(radius), level);
+	glm::ivec3 lastCell = getCell(hit.point + glm::vec3(radius), level);
+
+	for (int x = firstCell.x; x <= lastCell.x; x++)
+	{
+		for (int y = firstCell.y; y <= lastCell.y; y++)
+		{
+			for (int z = firstCell.z; z <= lastCell.z; z++)
+			{
+				uint64_t key = getCellKey(glm::ivec3(x, y, z), level);
+				Shard& shard = getShard(key);
+				std::unique_lock<std::shared_mutex> lock(shard.mutex);
+				shard.cells[key].push_back(sample);
+			}
+		}
+	}
+
+	numSamples++;
+}
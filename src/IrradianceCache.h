@@ -0,0 +1,83 @@
+#pragma once
+
+#include "GraphicalStructs.h"
+#include <shared_mutex>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+
+struct IrradianceCacheSettings
+{
+	bool enabled = false;
+	float spacing = .01; //how far a sample's lighting reaches, as a fraction of the length of the ray that found it (so samples far from the camera cover more)
+	float maxError = 4 / 255.0; //how far apart (as a fraction of full brightness) the samples around a point can be before the point is lit from scratch instead
+
+	bool operator==(const IrradianceCacheSettings& other) const { return enabled == other.enabled && spacing == other.spacing && maxError == other.maxError; }
+	bool operator!=(const IrradianceCacheSettings& other) const { return !(*this == other); }
+};
+
+/// <summary>
+/// Sparse samples of the direct light reaching opaque surfaces, shadows and light through transparent objects included. A sample stores its irradiance as a
+/// vector (the sum of the light vectors that reach it), so the diffuse shading of any normal near it is just a dot product, which also works on normal mapped surfaces.
+/// Samples are only used on the same face of the same object they were taken on, and wherever the samples around a point disagree by more than maxError
+/// (like at the edge of a shadow) the point has to be lit from scratch, so shadows stay sharp.
+///
+/// Samples are kept in hashed grids, one for every power of two cell size, with each sample in the grid whose cells are just big enough to hold its reach.
+/// Every render thread reads and adds samples at the same time. Which thread adds a sample first depends on timing, so with more than one thread the
+/// image can change by about maxError between renders
+/// </summary>
+class IrradianceCache
+{
+public:
+	IrradianceCache(float spacing, float maxError) : spacing(spacing), maxError(maxError) {}
+
+	/// <summary>
+	/// Interpolates the samples around the hit (using hit.point, hit.normal, hit.objectIndex and hit.face). Returns false if there aren't enough of them,
+	/// or if they don't agree closely enough to be interpolated. Either way, numNearby is set to how many samples reach the hit
+	/// </summary>
+	bool find(const HitRecord& hit, glm::vec3& irradiance, int& numNearby) const;
+
+	/// <summary>
+	/// Adds a sample of the irradiance at the hit, where numNearby is what find set it to. Nothing is added if there are already so many samples around
+	/// the hit that another one wouldn't help (the samples near a shadow's edge never agree, so without a limit they would keep piling up there)
+	/// </summary>
+	void add(const HitRecord& hit, const glm::vec3& irradiance, int numNearby);
+
+	size_t getNumSamples() const { return numSamples; }
+
+private:
+	static const int NUM_SHARDS = 64; //cells are spread over this many separately locked maps, so threads rarely wait on each other
+	static const int MIN_LEVEL = -16; //cells are 2^level across, for levels from MIN_LEVEL to MAX_LEVEL
+	static const int MAX_LEVEL = 15;
+	static const int MIN_SAMPLES = 3; //the fewest samples a point's lighting is interpolated from
+	static const int MAX_SAMPLES = 12; //the most samples reaching any point
+
+	struct Sample
+	{
+		glm::vec3 point;
+		glm::vec3 irradiance;
+		float radius;
+		int objectIndex;
+		int face;
+	};
+
+	struct Shard
+	{
+		mutable std::shared_mutex mutex;
+		std::unordered_map<uint64_t, vector<Sample>> cells;
+	};
+
+	float spacing;
+	float maxError;
+	Shard shards[NUM_SHARDS];
+	std::atomic<size_t> numSamples = { 0 };
+
+	//how far a sample taken at the hit reaches, and which grid it goes in
+	float getRadius(const HitRecord& hit) const;
+	static int getLevel(float radius);
+
+	static glm::ivec3 getCell(const glm::vec3& point, int level);
+	static uint64_t getCellKey(const glm::ivec3& cell, int level);
+	Shard& getShard(uint64_t key) { return shards[(key * 0x9E3779B97F4A7C15ull) >> 58]; }
+	const Shard& getShard(uint64_t key) const { return shards[(key * 0x9E3779B97F4A7C15ull) >> 58]; }
+};
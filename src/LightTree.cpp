@@ -0,0 +1,71 @@
+#include "LightTree.h"
+#include <algorithm>
+
+//--------------------------------------------------------------
+
+void LightTree::build(const vector<shared_ptr<Light>>& lights)
+{
+	nodes.clear();
+	leafLights.clear();
+
+	if (lights.empty())
+		return;
+
+	vector<BuildLight> buildLights;
+	buildLights.reserve(lights.size());
+
+	for (int i = 0; i < (int)lights.size(); i++)
+	{
+		BuildLight buildLight;
+		buildLight.index = i;
+		buildLight.bounds = lights[i]->getBounds();
+		buildLight.centroid = buildLight.bounds.getCenter();
+		buildLights.push_back(buildLight);
+	}
+
+	nodes.reserve(2 * buildLights.size());
+	buildNode(buildLights, 0, buildLights.size(), 0);
+
+	leafLights.reserve(buildLights.size());
+	for (BuildLight& buildLight : buildLights)
+		leafLights.push_back(buildLight.index);
+}
+
+int LightTree::buildNode(vector<BuildLight>& buildLights, int begin, int end, int depth)
+{
+	int nodeIndex = nodes.size();
+	nodes.push_back(Node());
+
+	AABB bounds, centroidBounds;
+	for (int i = begin; i < end; i++)
+	{
+		bounds.grow(buildLights[i].bounds);
+		centroidBounds.grow(buildLights[i].centroid);
+	}
+
+	nodes[nodeIndex].bounds = bounds;
+
+	if (end - begin <= MAX_LEAF_SIZE || depth >= MAX_DEPTH)
+	{
+		nodes[nodeIndex].offset = begin;
+		nodes[nodeIndex].numLights = end - begin;
+		return nodeIndex;
+	}
+
+	//there are far fewer lights than objects and every one of them is looked up the same way, so a median split along the widest axis is good enough
+	glm::vec3 extent = centroidBounds.maxCorner - centroidBounds.minCorner;
+	int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+	int mid = (begin + end) / 2;
+
+	std::nth_element(buildLights.begin() + begin, buildLights.begin() + mid, buildLights.begin() + end,
+		[axis](const BuildLight& a, const BuildLight& b) { return a.centroid[axis] < b.centroid[axis]; });
+
+	buildNode(buildLights, begin, mid, depth + 1);
+	int rightChild = buildNode(buildLights, mid, end, depth + 1);
+
+	//the nodes vector may have been reallocated by the recursive calls, so the node has to be looked up again
+	nodes[nodeIndex].offset = rightChild;
+	nodes[nodeIndex].numLights = 0;
+
+	return nodeIndex;
+}
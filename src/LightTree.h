@@ -0,0 +1,72 @@
+#pragma once
+
+#include "GraphicalStructs.h"
+
+/// <summary>
+/// Bounding volume hierarchy over a scene's lights, built from the boxes around everything each light can reach (see Light::getBounds).
+/// Finding the lights that can reach a point only walks the branches whose boxes hold it, so a scene with hundreds of lights only looks at the few nearby.
+/// Like the BVH, it only stores indices into the list it was built from
+/// </summary>
+class LightTree
+{
+public:
+	void build(const vector<shared_ptr<Light>>& lights);
+
+	/// <summary>
+	/// Calls visit(lightIndex) for every light whose bounds hold the point. The light still has to be checked with Light::canLight, since its bounds are only a box
+	/// </summary>
+	template<typename Visit>
+	void forEachLightAt(const glm::vec3& point, Visit visit) const
+	{
+		if (nodes.empty())
+			return;
+
+		int stack[STACK_SIZE];
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+
+		while (stackSize > 0)
+		{
+			int nodeIndex = stack[--stackSize];
+			const Node& node = nodes[nodeIndex];
+
+			if (!node.bounds.contains(point))
+				continue;
+
+			if (node.numLights > 0)
+			{
+				for (int i = node.offset; i < node.offset + node.numLights; i++)
+					visit(leafLights[i]);
+			}
+			else
+			{
+				stack[stackSize++] = node.offset;
+				stack[stackSize++] = nodeIndex + 1;
+			}
+		}
+	}
+
+private:
+	static const int MAX_LEAF_SIZE = 4;
+	static const int MAX_DEPTH = 48;
+	static const int STACK_SIZE = MAX_DEPTH + 16;
+
+	struct Node
+	{
+		AABB bounds;
+		int offset; //the index of the right child for interior nodes (the left child always comes right after its parent), or the first light for leaves
+		int numLights; //0 for interior nodes
+	};
+
+	struct BuildLight
+	{
+		int index;
+		AABB bounds;
+		glm::vec3 centroid;
+	};
+
+	vector<Node> nodes;
+	vector<int> leafLights; //lights referenced by the leaves, grouped so that every leaf's lights are contiguous
+
+	int buildNode(vector<BuildLight>& buildLights, int begin, int end, int depth);
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+/// <summary>
+/// A read-only view of a whole file, memory mapped so that the OS pages it in as it's used instead of reading it all up front.
+/// The mapping is copy-on-write, so the data can be handed to APIs that want non-const pointers as long as they don't actually write to it
+/// </summary>
+class MappedFile
+{
+public:
+	MappedFile() : data(nullptr), size(0), mappingHandle(nullptr) {}
+	~MappedFile() { close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& path);
+	void close();
+
+	bool isOpen() const { return data != nullptr; }
+	unsigned char* getData() const { return data; }
+	size_t getSize() const { return size; }
+
+private:
+	unsigned char* data;
+	size_t size;
+	void* mappingHandle; //only used on Windows, where the mapping object has to stay open as long as the view does
+};
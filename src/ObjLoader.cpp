@@ -0,0 +1,453 @@
+#include "ObjLoader.h"
+#include "MappedFile.h"
+#include <thread>
+#include <climits>
+
+//--------------------------------------------------------------
+
+namespace
+{
+	//marks a face corner that doesn't have a texture coordinate or normal
+	const int MISSING_INDEX = INT_MIN;
+
+	//don't bother splitting files smaller than this across threads
+	const size_t MIN_CHUNK_SIZE = 1 << 20;
+
+	//indices as they are written in the file. Positive OBJ indices count from the start of the file, so they can be resolved right away,
+	//but negative ones count back from the current position, which a chunk only knows relative to its own start until every chunk is parsed
+	struct Corner
+	{
+		int v, vt, vn;
+		unsigned char relative; //RELATIVE_* bits set for the indices that are relative to the start of the chunk
+	};
+
+	const unsigned char RELATIVE_V = 1;
+	const unsigned char RELATIVE_VT = 2;
+	const unsigned char RELATIVE_VN = 4;
+
+	struct Chunk
+	{
+		const char* begin;
+		const char* end;
+
+		vector<glm::vec3> verts;
+		vector<glm::vec2> uvs;
+		vector<glm::vec3> normals;
+		vector<Corner> corners; //three per triangle
+		vector<Corner> polygon; //reused for every face so that parsing doesn't allocate
+
+		bool hasUVs = false;
+		bool hasNormals = false;
+
+		//how many of each thing come before this chunk, filled in once every chunk has been parsed
+		int vertBase = 0;
+		int uvBase = 0;
+		int normalBase = 0;
+		size_t triangleBase = 0;
+
+		bool invalidIndex = false;
+	};
+
+	inline bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+	inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+	inline const char* skipSpaces(const char* p, const char* end)
+	{
+		while (p < end && isSpace(*p))
+			p++;
+		return p;
+	}
+
+	//parses a float without making a string or depending on the locale. Returns nullptr if there isn't a number at p
+	const char* parseFloat(const char* p, const char* end, float& value)
+	{
+		static const double POWERS_OF_TEN[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18 };
+
+		p = skipSpaces(p, end);
+
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+			negative = *p++ == '-';
+
+		double mantissa = 0;
+		int exponent = 0;
+		bool hasDigits = false;
+
+		for (; p < end && isDigit(*p); p++, hasDigits = true)
+			mantissa = mantissa * 10 + (*p - '0');
+
+		if (p < end && *p == '.')
+		{
+			for (p++; p < end && isDigit(*p); p++, hasDigits = true)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				exponent--;
+			}
+		}
+
+		if (!hasDigits)
+			return nullptr;
+
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			const char* exponentStart = p++;
+			bool negativeExponent = false;
+
+			if (p < end && (*p == '-' || *p == '+'))
+				negativeExponent = *p++ == '-';
+
+			if (p < end && isDigit(*p))
+			{
+				int writtenExponent = 0;
+				for (; p < end && isDigit(*p); p++)
+					writtenExponent = min(writtenExponent * 10 + (*p - '0'), 10000);
+
+				exponent += negativeExponent ? -writtenExponent : writtenExponent;
+			}
+			//an 'e' without digits after it isn't part of the number
+			else
+			{
+				p = exponentStart;
+			}
+		}
+
+		if (exponent < 0 && -exponent <= 18)
+			mantissa /= POWERS_OF_TEN[-exponent];
+		else if (exponent > 0 && exponent <= 18)
+			mantissa *= POWERS_OF_TEN[exponent];
+		else if (exponent != 0)
+			mantissa *= pow(10.0, exponent);
+
+		value = negative ? -mantissa : mantissa;
+		return p;
+	}
+
+	const char* parseInt(const char* p, const char* end, int& value)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+			negative = *p++ == '-';
+
+		if (p >= end || !isDigit(*p))
+			return nullptr;
+
+		long long result = 0;
+		for (; p < end && isDigit(*p); p++)
+			result = min(result * 10 + (*p - '0'), (long long)INT_MAX);
+
+		value = negative ? -result : result;
+		return p;
+	}
+
+	//turns an index as written in the file into a 0-based one, which is either absolute or relative to the start of the chunk
+	inline int resolveIndex(int index, int countSoFar, unsigned char relativeFlag, unsigned char& relative)
+	{
+		if (index > 0)
+			return index - 1;
+
+		relative |= relativeFlag;
+		return countSoFar + index;
+	}
+
+	//parses a face corner like "v", "v/vt", "v//vn" or "v/vt/vn"
+	const char* parseCorner(const char* p, const char* end, Chunk& chunk, Corner& corner)
+	{
+		corner.vt = MISSING_INDEX;
+		corner.vn = MISSING_INDEX;
+		corner.relative = 0;
+
+		int index;
+		p = parseInt(p, end, index);
+		if (p == nullptr || index == 0)
+			return nullptr;
+
+		corner.v = resolveIndex(index, chunk.verts.size(), RELATIVE_V, corner.relative);
+
+		if (p < end && *p == '/')
+		{
+			p++;
+
+			if (p < end && *p != '/')
+			{
+				p = parseInt(p, end, index);
+				if (p == nullptr || index == 0)
+					return nullptr;
+
+				corner.vt = resolveIndex(index, chunk.uvs.size(), RELATIVE_VT, corner.relative);
+				chunk.hasUVs = true;
+			}
+
+			if (p < end && *p == '/')
+			{
+				p = parseInt(p + 1, end, index);
+				if (p == nullptr || index == 0)
+					return nullptr;
+
+				corner.vn = resolveIndex(index, chunk.normals.size(), RELATIVE_VN, corner.relative);
+				chunk.hasNormals = true;
+			}
+		}
+
+		return p;
+	}
+
+	void parseLine(const char* p, const char* end, Chunk& chunk)
+	{
+		p = skipSpaces(p, end);
+
+		if (end - p < 2)
+			return;
+
+		if (p[0] == 'v' && isSpace(p[1]))
+		{
+			glm::vec3 vert;
+			p += 1;
+			for (int i = 0; i < 3 && p != nullptr; i++)
+				p = parseFloat(p, end, vert[i]);
+
+			chunk.verts.push_back(vert); //vertices are always added, even if they are malformed, so that the indices of later vertices don't shift
+		}
+		else if (p[0] == 'v' && p[1] == 't' && end - p > 2 && isSpace(p[2]))
+		{
+			glm::vec2 uv;
+			p = parseFloat(p + 2, end, uv[0]);
+			if (p != nullptr && parseFloat(p, end, uv[1]) == nullptr)
+				uv[1] = 0; //1D texture coordinates only have u
+
+			chunk.uvs.push_back(uv);
+		}
+		else if (p[0] == 'v' && p[1] == 'n' && end - p > 2 && isSpace(p[2]))
+		{
+			glm::vec3 normal;
+			p += 2;
+			for (int i = 0; i < 3 && p != nullptr; i++)
+				p = parseFloat(p, end, normal[i]);
+
+			chunk.normals.push_back(normal);
+		}
+		else if (p[0] == 'f' && isSpace(p[1]))
+		{
+			chunk.polygon.clear();
+			p++;
+
+			while (true)
+			{
+				p = skipSpaces(p, end);
+				if (p >= end || *p == '#')
+					break;
+
+				Corner corner;
+				p = parseCorner(p, end, chunk, corner);
+
+				if (p == nullptr)
+				{
+					chunk.invalidIndex = true;
+					return;
+				}
+
+				chunk.polygon.push_back(corner);
+			}
+
+			//fan triangulation, which works for the convex polygons OBJ files are supposed to contain
+			for (size_t i = 2; i < chunk.polygon.size(); i++)
+			{
+				chunk.corners.push_back(chunk.polygon[0]);
+				chunk.corners.push_back(chunk.polygon[i - 1]);
+				chunk.corners.push_back(chunk.polygon[i]);
+			}
+		}
+		//comments, groups, materials and everything else aren't needed for ray tracing
+	}
+
+	void parseChunk(Chunk& chunk)
+	{
+		const char* p = chunk.begin;
+
+		while (p < chunk.end)
+		{
+			const char* lineEnd = static_cast<const char*>(memchr(p, '\n', chunk.end - p));
+			if (lineEnd == nullptr)
+				lineEnd = chunk.end;
+
+			parseLine(p, lineEnd, chunk);
+			p = lineEnd + 1;
+		}
+	}
+
+	inline int finalIndex(int index, unsigned char relative, unsigned char relativeFlag, int base, int count, bool& invalid)
+	{
+		if (index == MISSING_INDEX)
+			return -1;
+
+		if (relative & relativeFlag)
+			index += base;
+
+		if (index < 0 || index >= count)
+			invalid = true;
+
+		return index;
+	}
+
+	//copies a chunk's results into their place in the mesh, which was already sized to fit every chunk
+	void copyChunkToMesh(Chunk& chunk, Mesh& mesh, bool keepUVs, bool keepNormals)
+	{
+		std::copy(chunk.verts.begin(), chunk.verts.end(), mesh.verts.begin() + chunk.vertBase);
+		std::copy(chunk.uvs.begin(), chunk.uvs.end(), mesh.uvs.begin() + chunk.uvBase);
+		std::copy(chunk.normals.begin(), chunk.normals.end(), mesh.normals.begin() + chunk.normalBase);
+
+		int numVerts = mesh.verts.size();
+		int numUVs = mesh.uvs.size();
+		int numNormals = mesh.normals.size();
+
+		for (size_t i = 0; i < chunk.corners.size(); i += 3)
+		{
+			int v[3], vt[3], vn[3];
+
+			for (int j = 0; j < 3; j++)
+			{
+				const Corner& c = chunk.corners[i + j];
+				v[j] = finalIndex(c.v, c.relative, RELATIVE_V, chunk.vertBase, numVerts, chunk.invalidIndex);
+				vt[j] = finalIndex(c.vt, c.relative, RELATIVE_VT, chunk.uvBase, numUVs, chunk.invalidIndex);
+				vn[j] = finalIndex(c.vn, c.relative, RELATIVE_VN, chunk.normalBase, numNormals, chunk.invalidIndex);
+			}
+
+			size_t triangle = chunk.triangleBase + i / 3;
+			mesh.triangles[triangle] = Tri(v[0], v[1], v[2]);
+
+			if (keepUVs)
+				mesh.uvTriangles[triangle] = Tri(vt[0], vt[1], vt[2]);
+
+			if (keepNormals)
+				mesh.normalTriangles[triangle] = Tri(vn[0], vn[1], vn[2]);
+		}
+
+		//the chunk's memory isn't needed anymore, and for big files it adds up
+		vector<glm::vec3>().swap(chunk.verts);
+		vector<glm::vec2>().swap(chunk.uvs);
+		vector<glm::vec3>().swap(chunk.normals);
+		vector<Corner>().swap(chunk.corners);
+	}
+
+	template<typename Function>
+	void runOnChunks(vector<Chunk>& chunks, Function function)
+	{
+		if (chunks.size() == 1)
+		{
+			function(chunks[0]);
+			return;
+		}
+
+		vector<std::thread> threads;
+		for (Chunk& chunk : chunks)
+			threads.emplace_back([&function, &chunk]() { function(chunk); });
+
+		for (std::thread& t : threads)
+			t.join();
+	}
+}
+
+//--------------------------------------------------------------
+
+bool parseObj(const char* begin, const char* end, Mesh& mesh, int numThreads)
+{
+	mesh = Mesh();
+
+	if (numThreads <= 0)
+		numThreads = max(1, (int)std::thread::hardware_concurrency());
+
+	size_t size = end - begin;
+	int numChunks = max((size_t)1, min((size_t)numThreads, size / MIN_CHUNK_SIZE));
+
+	//split the file into roughly equal chunks, moving each split forward to the start of the next line
+	vector<Chunk> chunks(numChunks);
+	const char* chunkBegin = begin;
+
+	for (int i = 0; i < numChunks; i++)
+	{
+		const char* chunkEnd = i == numChunks - 1 ? end : begin + size * (i + 1) / numChunks;
+
+		if (chunkEnd < chunkBegin)
+			chunkEnd = chunkBegin;
+
+		const char* newline = static_cast<const char*>(memchr(chunkEnd, '\n', end - chunkEnd));
+		chunkEnd = newline == nullptr ? end : newline + 1;
+
+		chunks[i].begin = chunkBegin;
+		chunks[i].end = chunkEnd;
+		chunkBegin = chunkEnd;
+	}
+
+	runOnChunks(chunks, parseChunk);
+
+	//now that every chunk knows how much it holds, work out where each one's data goes in the mesh
+	size_t numVerts = 0, numUVs = 0, numNormals = 0, numTriangles = 0;
+	bool keepUVs = false, keepNormals = false;
+
+	for (Chunk& chunk : chunks)
+	{
+		if (chunk.invalidIndex)
+		{
+			ofLogError("parseObj") << "found a face with a malformed or zero index";
+			return false;
+		}
+
+		chunk.vertBase = numVerts;
+		chunk.uvBase = numUVs;
+		chunk.normalBase = numNormals;
+		chunk.triangleBase = numTriangles;
+
+		numVerts += chunk.verts.size();
+		numUVs += chunk.uvs.size();
+		numNormals += chunk.normals.size();
+		numTriangles += chunk.corners.size() / 3;
+
+		keepUVs = keepUVs || chunk.hasUVs;
+		keepNormals = keepNormals || chunk.hasNormals;
+	}
+
+	if (numVerts > INT_MAX || numUVs > INT_MAX || numNormals > INT_MAX)
+	{
+		ofLogError("parseObj") << "the mesh has too many vertices to index with an int";
+		return false;
+	}
+
+	mesh.verts.resize(numVerts);
+	mesh.uvs.resize(numUVs);
+	mesh.normals.resize(numNormals);
+	mesh.triangles.resize(numTriangles, Tri(0, 0, 0));
+
+	if (keepUVs)
+		mesh.uvTriangles.resize(numTriangles, Tri(-1, -1, -1));
+
+	if (keepNormals)
+		mesh.normalTriangles.resize(numTriangles, Tri(-1, -1, -1));
+
+	runOnChunks(chunks, [&](Chunk& chunk) { copyChunkToMesh(chunk, mesh, keepUVs, keepNormals); });
+
+	for (Chunk& chunk : chunks)
+	{
+		if (chunk.invalidIndex)
+		{
+			ofLogError("parseObj") << "found a face that references a vertex, texture coordinate or normal that doesn't exist";
+			mesh = Mesh();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool loadObj(const string& path, Mesh& mesh, int numThreads)
+{
+	MappedFile file;
+
+	if (!file.open(path))
+	{
+		ofLogError("loadObj") << "couldn't open " << path;
+		mesh = Mesh();
+		return false;
+	}
+
+	const char* data = reinterpret_cast<const char*>(file.getData());
+	return parseObj(data, data + file.getSize(), mesh, numThreads);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "GraphicalStructs.h"
+
+/**
+ * Wavefront OBJ loading. The file is memory mapped and split into chunks at line boundaries, which are parsed in parallel straight
+ * from the mapped memory (no strings or streams are made per token). Polygons are fan triangulated, and texture coordinates and normals
+ * are kept along with the index triples that go with each triangle.
+ */
+
+/// <summary>
+/// Loads the OBJ file at path into mesh, replacing whatever it held. numThreads = 0 uses every hardware thread.
+/// Returns false (and leaves mesh empty) if the file can't be opened or references vertices that don't exist
+/// </summary>
+bool loadObj(const string& path, Mesh& mesh, int numThreads = 0);
+
+/// <summary>
+/// Parses OBJ text that is already in memory. Used by loadObj and Mesh's operator>>
+/// </summary>
+bool parseObj(const char* begin, const char* end, Mesh& mesh, int numThreads = 0);
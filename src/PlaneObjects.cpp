@@ -1,32 +1,53 @@
 #include "PlaneObjects.h"
+#include <thread>
+#include <mutex>
 
 Plane::Plane(glm::vec3 corner, float width, float height, Axis planeAxis, ofColor diffuseColor, ofColor spectralColor, bool reflective, float reflectance)
-	: SceneObject(diffuseColor, spectralColor), width(width), height(height), axis(planeAxis), epsilon(.0001), reflective(reflective), reflectance(reflectance)
+	: SceneObject(diffuseColor, spectralColor), width(width), height(height), corner(corner), axis(planeAxis), epsilon(.0001), reflective(reflective), reflectance(reflectance)
+{
+	switch (planeAxis)
+	{
+	case Axis::XY: normal = glm::vec3(0, 0, 1); break;
+	case Axis::XZ: normal = glm::vec3(0, 1, 0); break;
+	case Axis::YZ: normal = glm::vec3(1, 0, 0); break;
+	}
+}
+
+void Plane::getCorners(glm::vec3 corners[4])
 {
 	glm::vec3 widthVec, heightVec;
 
-	switch (planeAxis)
+	switch (axis)
 	{
-	case Axis::XY: widthVec = glm::vec3(width, 0, 0); heightVec = glm::vec3(0, -height, 0); normal = glm::vec3(0, 0, 1); break;
-	case Axis::XZ: widthVec = glm::vec3(width, 0, 0); heightVec = glm::vec3(0, 0, height); normal = glm::vec3(0, 1, 0);  break;
-	case Axis::YZ: widthVec = glm::vec3(0, -height, 0); heightVec = glm::vec3(0, 0, width); normal = glm::vec3(1, 0, 0);  break;
+	case Axis::XY: widthVec = glm::vec3(width, 0, 0); heightVec = glm::vec3(0, -height, 0); break;
+	case Axis::XZ: widthVec = glm::vec3(width, 0, 0); heightVec = glm::vec3(0, 0, height); break;
+	case Axis::YZ: widthVec = glm::vec3(0, -height, 0); heightVec = glm::vec3(0, 0, width); break;
 	}
 
-	m.verts.push_back(corner); //upper 'left' corner
-	m.verts.push_back(corner + widthVec); //upper 'right' corner
-	m.verts.push_back(corner + heightVec); //bottom 'left' corner
-	m.verts.push_back(corner + widthVec + heightVec); //bottom 'right' corner
+	corners[0] = corner; //upper 'left' corner
+	corners[1] = corner + widthVec; //upper 'right' corner
+	corners[2] = corner + heightVec; //bottom 'left' corner
+	corners[3] = corner + widthVec + heightVec; //bottom 'right' corner
+}
 
-	m.triangles.push_back(Tri(0, 2, 1));
-	m.triangles.push_back(Tri(1, 2, 3));
+void Plane::draw()
+{
+	glm::vec3 corners[4];
+	getCorners(corners);
+
+	ofSetColor(getDiffuseColor());
+	ofSetLineWidth(1);
+	ofNoFill();
+	ofDrawTriangle(corners[0], corners[2], corners[1]);
+	ofDrawTriangle(corners[1], corners[2], corners[3]);
 }
 
 bool Plane::insideFinitePlane(const glm::vec3& point)
 {
 	bool pointIsInside = false;
-	float x = m.verts[0][0];
-	float y = m.verts[0][1];
-	float z = m.verts[0][2];
+	float x = corner[0];
+	float y = corner[1];
+	float z = corner[2];
 
 	switch (axis)
 	{
@@ -41,9 +62,9 @@ bool Plane::insideFinitePlane(const glm::vec3& point)
 bool Plane::onInfinitePlane(const glm::vec3& point)
 {
 	bool pointOnPlane = false;
-	float x = m.verts[0][0];
-	float y = m.verts[0][1];
-	float z = m.verts[0][2];
+	float x = corner[0];
+	float y = corner[1];
+	float z = corner[2];
 
 	switch (axis)
 	{
@@ -60,7 +81,7 @@ glm::vec2 Plane::parameterizePoint(const glm::vec3& point)
 	float u = 0;
 	float v = 0;
 
-	glm::vec3 upperLeftHandCorner = m.verts[0];
+	glm::vec3 upperLeftHandCorner = corner;
 
 	switch (axis)
 	{
@@ -72,33 +93,58 @@ glm::vec2 Plane::parameterizePoint(const glm::vec3& point)
 	return glm::vec2(u, v);
 }
 
-bool Plane::intersects(const Ray& ray, glm::vec3& intersectPoint, glm::vec3& intersectNormal)
+bool Plane::intersects(const Ray& ray, HitRecord& hit)
 {
-	glm::vec3 truePlaneNormal = normal * getNormalSign(ray);
+	if (!Plane::getShape().quad.intersects(ray, hit.point, hit.distance))
+		return false;
 
-	float distance;
-	bool rayIntersects = glm::intersectRayPlane(ray.origin, ray.direction, m.verts[0], truePlaneNormal, distance); //calculates intersection for an infinite plane
+	hit.normal = normal * getNormalSign(ray);
+	hit.uv = parameterizePoint(hit.point);
+	return true;
+}
 
-	if (rayIntersects && distance <= ray.maxDistance)
-	{
-		glm::vec3 point = ray.origin + distance * ray.direction; //get the point of intersection on the infinite plane
+bool Plane::occludes(const Ray& ray)
+{
+	//goes to the plane's shape directly so that subclasses like NormalPlane don't sample their normal maps for shadow rays
+	return Plane::getShape().quad.occludes(ray);
+}
 
-		if (insideFinitePlane(point)) //if the intersection point on the infinite plane is also on the finite plane, then do stuff
-		{
-			intersectPoint = point;
-			intersectNormal = truePlaneNormal;
-		}
-		else //if the ray intersects with the infinite plane, but not the finite plane, then rayIntersect should be false
-		{
-			rayIntersects = false;
-		}
-	}
-	else //if the ray doesn't intersect, or it intersects, but it intersect is too far away, then rayIntersects should be false
+PrimitiveShape Plane::getShape()
+{
+	//the plane is axis aligned, so only the coordinate along its normal decides where a ray crosses it,
+	//and only the two coordinates across it decide whether that point is inside the finite plane (see insideFinitePlane)
+	QuadShape quad = {};
+
+	switch (axis)
 	{
-		rayIntersects = false;
+	case Axis::XY: quad.normalAxis = 2; quad.uAxis = 0; quad.vAxis = 1; quad.uMin = corner[0]; quad.uMax = corner[0] + width; quad.vMin = corner[1] - height; quad.vMax = corner[1]; break;
+	case Axis::XZ: quad.normalAxis = 1; quad.uAxis = 0; quad.vAxis = 2; quad.uMin = corner[0]; quad.uMax = corner[0] + width; quad.vMin = corner[2]; quad.vMax = corner[2] + height; break;
+	case Axis::YZ: quad.normalAxis = 0; quad.uAxis = 1; quad.vAxis = 2; quad.uMin = corner[1] - height; quad.uMax = corner[1]; quad.vMin = corner[2]; quad.vMax = corner[2] + width; break;
 	}
 
-	return rayIntersects;
+	quad.coordinate = corner[quad.normalAxis];
+
+	PrimitiveShape shape;
+	shape.type = PrimitiveShape::Type::QUAD;
+	shape.quad = quad;
+
+	return shape;
+}
+
+AABB Plane::getBounds()
+{
+	AABB bounds;
+
+	glm::vec3 corners[4];
+	getCorners(corners);
+
+	for (glm::vec3 vert : corners)
+		bounds.grow(vert);
+
+	//planes have no thickness, so give the box a little bit of depth so that rays parallel to the plane don't slip between its min and max
+	bounds.pad(epsilon);
+
+	return bounds;
 }
 
 int Plane::getNormalSign(Ray ray)
@@ -107,9 +153,9 @@ int Plane::getNormalSign(Ray ray)
 
 	switch (axis) //by default, normal points in the positive direction. This checks to see if the ray came from the negative direction
 	{
-	case Axis::XY: if (ray.origin[2] < m.verts[0][2]) normalSign = -1; break;
-	case Axis::XZ: if (ray.origin[1] < m.verts[0][1]) normalSign = -1; break;
-	case Axis::YZ: if (ray.origin[0] < m.verts[0][0]) normalSign = -1; break;
+	case Axis::XY: if (ray.origin[2] < corner[2]) normalSign = -1; break;
+	case Axis::XZ: if (ray.origin[1] < corner[1]) normalSign = -1; break;
+	case Axis::YZ: if (ray.origin[0] < corner[0]) normalSign = -1; break;
 	}
 
 	return normalSign;
@@ -118,420 +164,462 @@ int Plane::getNormalSign(Ray ray)
 //--------------------------------------------------------------
 
 
-TexturedPlane::TexturedPlane(glm::vec3 upperLeftCorner, float width, float heigth, Axis planeAxis, float maxU, float maxV, shared_ptr<ofImage> texture)
+TexturedPlane::TexturedPlane(glm::vec3 upperLeftCorner, float width, float heigth, Axis planeAxis, float maxU, float maxV, shared_ptr<Texture> texture)
 	: Plane(upperLeftCorner, width, heigth, planeAxis, ofColor::darkGray, ofColor::black),
 	maxU(maxU), maxV(maxV), texture(texture)
 { }
 
-ofColor TexturedPlane::getDiffuseColor(const glm::vec3& point)
+ofColor TexturedPlane::getDiffuseColor(const HitRecord& hit)
 {
 	if (texture != nullptr)
-	{
-		glm::vec2 parameterizedVec = parameterizePoint(point);
+		return texture->sampleColor(hit.uv[0] * maxU, hit.uv[1] * maxV);
 
-		float u = parameterizedVec[0] * maxU;
-		float v = parameterizedVec[1] * maxV;
 
-		int x = fmod(u * texture->getWidth(), texture->getWidth());
-		int y = fmod(v * texture->getHeight(), texture->getHeight());
-
-		return texture->getColor(x, y);
-	}
-
-	Plane::getDiffuseColor();
+	return Plane::getDiffuseColor();
 }
 
 
 //--------------------------------------------------------------
 
 NormalPlane::NormalPlane(glm::vec3 upperLeftCorner, float width, float heigth, Axis planeAxis, float maxU, float maxV, 
-	shared_ptr<ofImage> texture, shared_ptr<ofImage> normalMap)
+	shared_ptr<Texture> texture, shared_ptr<Texture> normalMap)
 	: TexturedPlane(upperLeftCorner, width, heigth, planeAxis, maxU, maxV, texture), normalMap(normalMap)
 { }
 
-bool NormalPlane::intersects(const Ray& ray, glm::vec3& intersectPoint, glm::vec3& intersectNormal)
+bool NormalPlane::intersects(const Ray& ray, HitRecord& hit)
 {
-	bool rayIntersects = TexturedPlane::intersects(ray, intersectPoint, intersectNormal);
+	bool rayIntersects = TexturedPlane::intersects(ray, hit);
 
 	if (rayIntersects && normalMap != nullptr)
 	{
-		intersectNormal = getNormalAt(intersectPoint, ray);
+		hit.normal = getNormalAt(hit.uv, ray);
 	}
 
 	return rayIntersects;
 }
 
 
-glm::vec3 NormalPlane::getNormalAt(glm::vec3 point, Ray ray)
+glm::vec3 NormalPlane::getNormalAt(const glm::vec2& uv, const Ray& ray)
 {
-	glm::vec2 parameterizedVec = parameterizePoint(point);
-
-	float u = parameterizedVec[0] * maxU;
-	float v = parameterizedVec[1] * maxV;
+	//the normal map was decoded into vectors when it was loaded (see Texture), so all that's left is to line its axes up with the plane's
+	glm::vec3 mapNormal = normalMap->sampleNormal(uv[0] * maxU, uv[1] * maxV);
 
-	int x = fmod(u * normalMap->getWidth(), normalMap->getWidth());
-	int y = fmod(v * normalMap->getHeight(), normalMap->getHeight());
-
-	ofColor normalColor = normalMap->getColor(x, y);
-
-	int xColor = 255, yColor = 255, zColor = 255;
+	glm::vec3 normal;
 	switch (getAxis())
 	{
-	case Axis::XY: xColor = normalColor.r; yColor = normalColor.g; zColor = normalColor.b; break;
-	case Axis::XZ: xColor = normalColor.r; yColor = normalColor.b; zColor = normalColor.g; break;
-	case Axis::YZ: xColor = normalColor.b; yColor = normalColor.g; zColor = normalColor.r;  break;
+	case Axis::XY: normal = glm::vec3(mapNormal.x, mapNormal.y, mapNormal.z); break;
+	case Axis::XZ: normal = glm::vec3(mapNormal.x, mapNormal.z, mapNormal.y); break;
+	case Axis::YZ: normal = glm::vec3(mapNormal.z, mapNormal.y, mapNormal.x); break;
 	}
 
-	//normal math taken from https://learnopengl.com/Advanced-Lighting/Normal-Mapping
-	float normalX = (xColor / 255.0) * 2 - 1;
-	float normalY = (yColor / 255.0) * 2 - 1;
-	float normalZ = (zColor / 255.0) * 2 - 1;
-
-	return glm::normalize(glm::vec3(normalX, normalY, normalZ)) * getNormalSign(ray);
+	return glm::normalize(normal) * getNormalSign(ray);
 }
 
 //--------------------------------------------------------------
 
+//bands of rows smaller than this aren't worth a thread of their own
+static const int MIN_CELLS_PER_THREAD = 1 << 16;
 
-DisplacementPlane::DisplacementPlane(glm::vec3 upperLeftCorner, float width, float heigth, Axis planeAxis, int maxU, int maxV,
-	shared_ptr<ofImage> texture, shared_ptr<ofImage> normalMap, shared_ptr<ofImage> displacementMap, float displacementDepth)
-	: NormalPlane(upperLeftCorner, width, heigth, planeAxis, maxU, maxV, texture, normalMap), displacementMap(displacementMap), displacementDepth(displacementDepth), calculateNormal(false)
-{ 
-	if (normalMap == nullptr)
-		calculateNormal = true;
+/// <summary>
+/// Calls function(firstRow, endRow) on bands of rows that together cover [0, numRows), each on its own thread if there are enough cells to make that worth it
+/// </summary>
+template<typename Function>
+static void forEachRowBand(int numRows, int rowLength, Function function)
+{
+	int numThreads = max(1, (int)std::thread::hardware_concurrency());
+	int numBands = max(1, min({ numThreads, numRows, (int)((int64_t)numRows * rowLength / MIN_CELLS_PER_THREAD) }));
 
-	if (displacementMap != nullptr)
+	if (numBands == 1)
 	{
-		addDisplacementToMesh();
-		calculateBoundingBox();
+		function(0, numRows);
+		return;
 	}
-	
+
+	vector<std::thread> threads;
+	for (int band = 0; band < numBands; band++)
+		threads.emplace_back([&function, band, numBands, numRows]() { function((int64_t)band * numRows / numBands, (int64_t)(band + 1) * numRows / numBands); });
+
+	for (std::thread& t : threads)
+		t.join();
 }
 
-bool DisplacementPlane::intersects(const Ray& ray, glm::vec3& intersectPoint, glm::vec3& intersectNormal)
+Heightfield::Heightfield(const Texture& displacementMap, float depth)
+	: gridWidth(displacementMap.getWidth()), gridHeight(displacementMap.getHeight())
 {
-	bool rayIntersects = false;
-	bool hitsBox = intersectsBoundingBox(ray);
+	heights.resize((size_t)(gridWidth + 1) * (gridHeight + 1));
 
-	if (hitsBox)
+	//every corner is as high as the average of the (up to four) texels around it, so neighboring cells always meet
+	forEachRowBand(gridHeight + 1, gridWidth + 1, [&](int firstRow, int endRow)
 	{
-		int closestTri = -1;
-		float distance = std::numeric_limits<float>::infinity();
-		glm::vec3 point;
-		glm::vec3 normal;
-
-		for (int i = 0; i < heightMesh.triangles.size(); i++)
+		for (int y = firstRow; y < endRow; y++)
 		{
-			glm::vec3 curPoint;
-			glm::vec3 curNormal;
-			bool itIntersects = intersectsTriangle(ray, i, curPoint, curNormal);
-			float curDistance = glm::distance(curPoint, ray.origin);
-
-			if (itIntersects && curDistance < distance)
+			for (int x = 0; x <= gridWidth; x++)
 			{
-				point = curPoint;
-				normal = curNormal;
-				closestTri = i;
-				distance = curDistance;
-				rayIntersects = true;
+				float displacement = 0;
+				int adjacentPixels = 0;
+
+				for (int pixelY = max(y - 1, 0); pixelY <= min(y, gridHeight - 1); pixelY++)
+				{
+					for (int pixelX = max(x - 1, 0); pixelX <= min(x, gridWidth - 1); pixelX++)
+					{
+						displacement += displacementMap.getTexel(pixelX, pixelY)[0] / 255.0;
+						adjacentPixels++;
+					}
+				}
+
+				heights[(size_t)y * (gridWidth + 1) + x] = depth * displacement / adjacentPixels;
 			}
-
 		}
+	});
 
-		//if we didn't intersect with any triangles, just return false
-		if (closestTri == -1)
-			return false;
-
-		intersectPoint = point;
-
-		//if we did intersect with something, but we don't have a normal map, then we need to calculate the normal
-		if (calculateNormal)
-		{
-			//the 'normal' calculated by that function is not exactly normalized
-			normal = glm::normalize(normal);
-
-			glm::vec3 v1 = heightMesh.verts[heightMesh.triangles[closestTri].v1];
-			glm::vec3 v2 = heightMesh.verts[heightMesh.triangles[closestTri].v2];
-			glm::vec3 v3 = heightMesh.verts[heightMesh.triangles[closestTri].v3];
-			//now that we have the intersect point and the direction of the normal, we need to figure out it's sign, which changes depending on the origin of the ray
-			//code to determine the sign of the normal comes from here: https://math.stackexchange.com/a/214194
-			glm::vec3 B_prime = v2 - v1;
-			glm::vec3 C_prime = v3 - v1;
-			glm::vec3 X_prime = ray.origin - v1;
-			glm::mat3 M = glm::mat3(B_prime, C_prime, X_prime);
-			float matDeterminant = glm::determinant(M);
-
-			//by default, the normal is already the 'positive' normal, so we only need to check if it's 'negative'
-			if (matDeterminant < 0)
-				normal = -1 * normal;
-
-			intersectNormal = normal;
-		}
-		//if there is a normal map, just get the normal from that map
-		else
-		{
-			intersectNormal = NormalPlane::getNormalAt(intersectPoint, ray);
-		}
-	}
+	buildHeightBounds();
+}
 
-	return rayIntersects;
+Heightfield::Heightfield(int gridWidth, int gridHeight, vector<float> heights)
+	: gridWidth(gridWidth), gridHeight(gridHeight), heights(std::move(heights))
+{
+	buildHeightBounds();
 }
 
-void DisplacementPlane::addDisplacementToMesh()
+void Heightfield::buildHeightBounds()
 {
-	float pixelWidth = width / (maxU * displacementMap->getWidth());
-	float pixelHeight = height / (maxV * displacementMap->getHeight());
+	//the levels are all laid out up front so that the rows of each one can be filled in in parallel
+	levelOffsets.clear();
+	int numBounds = 0;
 
-	//this makes it so that currentLeftCorner.x and currentLeftCorner.z refer to points on the plane while currentLeftCorner.y refers to a displacement away from the plane
-	glm::vec3 upperLeftCorner = getUpperLeftCorner();
-	const float X = upperLeftCorner.x;
-	const float Y = upperLeftCorner.y;
-	const float Z = upperLeftCorner.z;
+	for (int level = 0; ; level++)
+	{
+		levelOffsets.push_back(numBounds);
+		numBounds += getLevelWidth(level) * getLevelHeight(level);
 
-	glm::vec3 lowerLeftCorner = glm::vec3(X, Y - pixelHeight, Z);
-	glm::vec3 upperRightCorner = glm::vec3(X + pixelWidth, Y, Z);
-	glm::vec3 lowerRightCorner = glm::vec3(X + pixelWidth, Y - pixelHeight, Z);
+		if (getLevelWidth(level) == 1 && getLevelHeight(level) == 1)
+			break;
+	}
 
-	int numVerts = 0;
+	heightBounds.resize(numBounds);
 
-	for (int i = 0; i < maxU; i++)
+	//level 0 bounds each cell by its corners, and every level after that bounds 2x2 blocks of the level below
+	for (int level = 0; level < getNumLevels(); level++)
 	{
-		for (int j = 0; j < maxV; j++)
+		forEachRowBand(getLevelHeight(level), getLevelWidth(level), [&](int firstRow, int endRow)
 		{
-			iterateOverDisplacementMap(pixelWidth, pixelHeight, X, Z, numVerts, upperLeftCorner, lowerLeftCorner, upperRightCorner, lowerRightCorner);
-		}
+			for (int y = firstRow; y < endRow; y++)
+			{
+				for (int x = 0; x < getLevelWidth(level); x++)
+				{
+					glm::vec2 bounds(std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity());
+
+					if (level == 0)
+					{
+						for (int corner = 0; corner < 4; corner++)
+						{
+							float cornerHeight = getHeight(x + corner % 2, y + corner / 2);
+							bounds = glm::vec2(min(bounds[0], cornerHeight), max(bounds[1], cornerHeight));
+						}
+					}
+					else
+					{
+						//blocks on the right and bottom edges may not have all four children
+						for (int childY = y * 2; childY < min(y * 2 + 2, getLevelHeight(level - 1)); childY++)
+						{
+							for (int childX = x * 2; childX < min(x * 2 + 2, getLevelWidth(level - 1)); childX++)
+							{
+								const glm::vec2& child = getHeightBounds(level - 1, childX, childY);
+								bounds = glm::vec2(min(bounds[0], child[0]), max(bounds[1], child[1]));
+							}
+						}
+					}
+
+					heightBounds[levelOffsets[level] + y * getLevelWidth(level) + x] = bounds;
+				}
+			}
+		});
 	}
 }
 
-/// <summary>
-/// Iterates over the displacement map add adds the vertices and triangles to the mesh
-/// </summary>
-/// <param name="UL">location of the upper-left hand corner for the first pixel</param>
-/// <param name="LL">location of the lower-left hand corner for the first pixel</param>
-/// <param name="UR">location of the upper-right hand corner for the first pixel</param>
-/// <param name="LR">location of the lower-right hand corner for the first pixel</param>
-void DisplacementPlane::iterateOverDisplacementMap(float pixelWidth, float pixelHeight, float baseX, float baseZ, int& numVerts, glm::vec3& UL, glm::vec3& LL, glm::vec3& UR, glm::vec3& LR)
+shared_ptr<const Heightfield> Heightfield::get(shared_ptr<Texture> displacementMap, float depth)
 {
-	for (int pixelY = 0; pixelY < displacementMap->getHeight(); pixelY++)
+	//the map is kept as a weak_ptr too, so that a new texture that happens to get the address of one that was freed doesn't pick up its heightfield
+	struct Entry
 	{
-		for (int pixelX = 0; pixelX < displacementMap->getWidth(); pixelX++)
-		{
-			//we calculate the displacement of a pixel as the average of the height map in the surrounding pixels
-			float displacement = displacementMap->getColor(pixelX, pixelY).r / 255.0;
-			// upper left corner
-			int adjacentPixelsUL = 1;
-			float dzUL = displacement;
-
-			if (pixelX != 0 && pixelY != 0){
-				dzUL += displacementMap->getColor(pixelX - 1, pixelY - 1).r / 255.0;
-				adjacentPixelsUL++;
-			}
-			if (pixelX != 0) {
-				dzUL += displacementMap->getColor(pixelX - 1, pixelY).r / 255.0;
-				adjacentPixelsUL++;
-			}
-			if (pixelY != 0) {
-				dzUL += displacementMap->getColor(pixelX, pixelY - 1).r / 255.0;
-				adjacentPixelsUL++;
-			}
-			
-			UL.z += dzUL / adjacentPixelsUL;
+		std::weak_ptr<Texture> displacementMap;
+		std::weak_ptr<const Heightfield> heightfield;
+	};
 
+	static std::mutex lock;
+	static map<pair<const Texture*, float>, Entry> heightfields;
 
-			// lower left corner
-			int adjacentPixelsLL = 1;
-			float dzLL = displacement;
+	std::lock_guard<std::mutex> guard(lock);
 
-			if (pixelX != 0 && pixelY != displacementMap->getHeight() - 1) {
-				dzLL += displacementMap->getColor(pixelX - 1, pixelY + 1).r / 255.0;
-				adjacentPixelsLL++;
-			}
-			if (pixelX != 0) {
-				dzLL += displacementMap->getColor(pixelX - 1, pixelY).r / 255.0;
-				adjacentPixelsLL++;
-			}
-			if (pixelY != displacementMap->getHeight() - 1) {
-				dzLL += displacementMap->getColor(pixelX, pixelY + 1).r / 255.0;
-				adjacentPixelsLL++;
-			}
+	pair<const Texture*, float> key(displacementMap.get(), depth);
+	auto existing = heightfields.find(key);
 
-			LL.z += dzLL / adjacentPixelsLL;
+	if (existing != heightfields.end() && existing->second.displacementMap.lock() == displacementMap)
+	{
+		if (shared_ptr<const Heightfield> heightfield = existing->second.heightfield.lock())
+			return heightfield;
+	}
 
-			//upper right corner
-			int adjacentPixelsUR = 1;
-			float dzUR = displacement;
+	shared_ptr<const Heightfield> heightfield = make_shared<Heightfield>(*displacementMap, depth);
+	heightfields[key] = { displacementMap, heightfield };
 
-			if (pixelX != displacementMap->getWidth() - 1 && pixelY != 0) {
-				dzUR += displacementMap->getColor(pixelX + 1, pixelY - 1).r / 255.0;
-				adjacentPixelsUR++;
-			}
-			if (pixelX != displacementMap->getWidth() - 1) {
-				dzUR += displacementMap->getColor(pixelX + 1, pixelY).r / 255.0;
-				adjacentPixelsUR++;
-			}
-			if (pixelY != 0) {
-				dzUR += displacementMap->getColor(pixelX, pixelY - 1).r / 255.0;
-				adjacentPixelsUR++;
-			}
-
-			UR.z += dzUR / adjacentPixelsUR;
+	return heightfield;
+}
 
-			//lower right corner
-			int adjacentPixelsLR = 1;
-			float dzLR = displacement;
+DisplacementPlane::DisplacementPlane(glm::vec3 upperLeftCorner, float width, float heigth, Axis planeAxis, int maxU, int maxV,
+	shared_ptr<Texture> texture, shared_ptr<Texture> normalMap, shared_ptr<Texture> displacementMap, float displacementDepth)
+	: NormalPlane(upperLeftCorner, width, heigth, planeAxis, maxU, maxV, texture, normalMap), displacementMap(displacementMap), displacementDepth(displacementDepth), calculateNormal(false)
+{ 
+	if (normalMap == nullptr)
+		calculateNormal = true;
 
-			if (pixelX != displacementMap->getWidth() - 1 && pixelY != displacementMap->getHeight() - 1) {
-				dzLR += displacementMap->getColor(pixelX + 1, pixelY + 1).r / 255.0;
-				adjacentPixelsLR++;
-			}
-			if (pixelX != displacementMap->getWidth() - 1) {
-				dzLR += displacementMap->getColor(pixelX + 1, pixelY).r / 255.0;
-				adjacentPixelsLR++;
-			}
-			if (pixelY != displacementMap->getHeight() - 1) {
-				dzLR += displacementMap->getColor(pixelX, pixelY + 1).r / 255.0;
-				adjacentPixelsLR++;
-			}
+	if (displacementMap != nullptr)
+		heightfield = Heightfield::get(displacementMap, displacementDepth);
+}
 
-			LR.z += dzLR / adjacentPixelsLR;
+bool DisplacementPlane::intersects(const Ray& ray, HitRecord& record)
+{
+	//without a displacement map this is just a normal mapped plane
+	if (heightfield == nullptr)
+		return NormalPlane::intersects(ray, record);
 
-			//now that we have set the displacement of all of the vertices, we need to add them to the mesh
-			heightMesh.verts.push_back(UL);
-			heightMesh.verts.push_back(LL);
-			heightMesh.verts.push_back(UR);
-			heightMesh.verts.push_back(LR);
+	HeightfieldHit hit;
+	if (!intersectHeightfield(ray, false, hit))
+		return false;
 
-			//we also have to add the triangles, then we can update the number of vertices
-			heightMesh.triangles.push_back(Tri(numVerts, numVerts + 1, numVerts + 2));
-			heightMesh.triangles.push_back(Tri(numVerts + 2, numVerts + 1, numVerts + 3));
+	record.distance = hit.distance;
+	record.point = hit.point;
 
-			numVerts += 4;
+	//the texture and normal map are laid over the displaced surface as if it were flat
+	record.uv = parameterizePoint(hit.point);
 
-			//now that we've added the vertices, we have to move the points and reset the Z values
-			UL.x += pixelWidth;
-			UL.z = baseZ;
+	//if we did intersect with something, but we don't have a normal map, then we need to calculate the normal
+	if (calculateNormal)
+	{
+		//the 'normal' calculated by intersectsTriangle is not exactly normalized
+		glm::vec3 normal = glm::normalize(hit.normal);
+
+		glm::vec3 v1 = hit.triangle[0];
+		glm::vec3 v2 = hit.triangle[1];
+		glm::vec3 v3 = hit.triangle[2];
+		//now that we have the intersect point and the direction of the normal, we need to figure out it's sign, which changes depending on the origin of the ray
+		//code to determine the sign of the normal comes from here: https://math.stackexchange.com/a/214194
+		glm::vec3 B_prime = v2 - v1;
+		glm::vec3 C_prime = v3 - v1;
+		glm::vec3 X_prime = ray.origin - v1;
+		glm::mat3 M = glm::mat3(B_prime, C_prime, X_prime);
+		float matDeterminant = glm::determinant(M);
+
+		//by default, the normal is already the 'positive' normal, so we only need to check if it's 'negative'
+		if (matDeterminant < 0)
+			normal = -1 * normal;
+
+		record.normal = normal;
+	}
+	//if there is a normal map, just get the normal from that map
+	else
+	{
+		record.normal = NormalPlane::getNormalAt(record.uv, ray);
+	}
 
-			LL.x += pixelWidth;
-			LL.z = baseZ;
+	return true;
+}
 
-			UR.x += pixelWidth;
-			UR.z = baseZ;
+bool DisplacementPlane::occludes(const Ray& ray)
+{
+	if (heightfield == nullptr)
+		return NormalPlane::occludes(ray);
 
-			LR.x += pixelWidth;
-			LR.z = baseZ;
-		}
+	//unlike intersects, we don't need the closest triangle, so we can stop at the first one that's hit
+	HeightfieldHit hit;
+	return intersectHeightfield(ray, true, hit);
+}
 
-		//now that we've iterated over a row, we have to go down a row
-		UL.x = baseX;
-		UL.y -= pixelHeight;
+AABB DisplacementPlane::getBounds()
+{
+	if (heightfield == nullptr)
+		return Plane::getBounds();
 
-		LL.x = baseX;
-		LL.y -= pixelHeight;
+	//the top level of the mipmap has the lowest and highest points of the whole surface
+	glm::vec3 corner = getUpperLeftCorner();
+	const glm::vec2& bounds = heightfield->heightBounds.back();
 
-		UR.x = baseX + pixelWidth;
-		UR.y -= pixelHeight;
+	AABB box(glm::vec3(corner.x, corner.y - height, corner.z + bounds[0]), glm::vec3(corner.x + width, corner.y, corner.z + bounds[1]));
+	box.pad(epsilon);
 
-		LR.x = baseX + pixelWidth;
-		LR.y -= pixelHeight;
-	}
+	return box;
 }
 
-
-void DisplacementPlane::calculateBoundingBox()
+bool DisplacementPlane::intersectHeightfield(const Ray& ray, bool anyHit, HeightfieldHit& hit)
 {
-	float minX = std::numeric_limits<float>::infinity();
-	float maxX = - std::numeric_limits<float>::infinity();
-	float minY = std::numeric_limits<float>::infinity();
-	float maxY = - std::numeric_limits<float>::infinity();
-	float minZ = std::numeric_limits<float>::infinity();
-	float maxZ = - std::numeric_limits<float>::infinity();
-
-	for (glm::vec3 vert : heightMesh.verts)
+	const glm::vec3& invDirection = ray.invDirection;
+
+	float tEntry;
+	if (!getBounds().intersects(ray.origin, invDirection, ray.maxDistance, tEntry))
+		return false;
+
+	hit.distance = ray.maxDistance;
+
+	//the repetitions of the map are walked through in the order the ray crosses them (a 2D DDA), so the first one with a hit has the closest hit.
+	//tileX counts repetitions to the right of the upper left corner and tileY counts them going down
+	glm::vec3 corner = getUpperLeftCorner();
+	int repeatU = max(1, (int)maxU);
+	int repeatV = max(1, (int)maxV);
+	float tileWidth = width / repeatU;
+	float tileHeight = height / repeatV;
+
+	glm::vec3 start = ray.origin + ray.direction * max(tEntry, 0.f);
+	int tileX = ofClamp(floor((start.x - corner.x) / tileWidth), 0, repeatU - 1);
+	int tileY = ofClamp(floor((corner.y - start.y) / tileHeight), 0, repeatV - 1);
+
+	int stepX = ray.direction.x > 0 ? 1 : -1;
+	int stepY = ray.direction.y < 0 ? 1 : -1;
+
+	//the distances along the ray to the next boundary between repetitions in each direction, and between one boundary and the next
+	float tNextX = std::numeric_limits<float>::infinity();
+	float tNextY = std::numeric_limits<float>::infinity();
+	float tDeltaX = std::numeric_limits<float>::infinity();
+	float tDeltaY = std::numeric_limits<float>::infinity();
+
+	if (ray.direction.x != 0)
 	{
-		if (vert[0] < minX)
-			minX = vert[0];
-		else if (vert[0] > maxX)
-			maxX = vert[0];
-
-		if (vert[1] < minY)
-			minY = vert[1];
-		else if (vert[1] > maxY)
-			maxY = vert[1];
-
-		if (vert[2] < minZ)
-			minZ = vert[2];
-		else if (vert[2] > maxZ)
-			maxZ = vert[2];
+		tNextX = (corner.x + (tileX + (stepX > 0)) * tileWidth - ray.origin.x) * invDirection.x;
+		tDeltaX = tileWidth * fabs(invDirection.x);
 	}
 
-	aabbMin = glm::vec3(minX, minY, minZ);
-	aabbMax = glm::vec3(maxX, maxY, maxZ);
-}
+	if (ray.direction.y != 0)
+	{
+		tNextY = (corner.y - (tileY + (stepY > 0)) * tileHeight - ray.origin.y) * invDirection.y;
+		tDeltaY = tileHeight * fabs(invDirection.y);
+	}
 
-//taken from https://www.scratchapixel.com/lessons/3d-basic-rendering/minimal-ray-tracer-rendering-simple-shapes/ray-box-intersection
-bool DisplacementPlane::intersectsBoundingBox(const Ray& r)
-{
-	float tmin = (aabbMin.x - r.origin.x) / r.direction.x;
-	float tmax = (aabbMax.x - r.origin.x) / r.direction.x;
+	while (true)
+	{
+		if (intersectTile(ray, invDirection, tileX, tileY, anyHit, hit))
+			return true;
 
-	if (tmin > tmax) swap(tmin, tmax);
+		float tExit = min(tNextX, tNextY);
+		if (tExit > hit.distance)
+			return false;
 
-	float tymin = (aabbMin.y - r.origin.y) / r.direction.y;
-	float tymax = (aabbMax.y - r.origin.y) / r.direction.y;
+		if (tNextX < tNextY)
+		{
+			tileX += stepX;
+			tNextX += tDeltaX;
+		}
+		else
+		{
+			tileY += stepY;
+			tNextY += tDeltaY;
+		}
 
-	if (tymin > tymax) swap(tymin, tymax);
+		if (tileX < 0 || tileX >= repeatU || tileY < 0 || tileY >= repeatV)
+			return false;
+	}
+}
 
-	if ((tmin > tymax) || (tymin > tmax))
-		return false;
+bool DisplacementPlane::intersectTile(const Ray& ray, const glm::vec3& invDirection, int tileX, int tileY, bool anyHit, HeightfieldHit& hit)
+{
+	struct Block
+	{
+		int level;
+		int x, y;
+	};
+
+	//every level pushes at most three blocks that are still waiting when its fourth is visited
+	const int MAX_LEVELS = 32;
+	Block stack[3 * MAX_LEVELS + 1];
+	int stackSize = 0;
+	stack[stackSize++] = { heightfield->getNumLevels() - 1, 0, 0 };
+
+	glm::vec3 corner = getUpperLeftCorner();
+	const Heightfield& field = *heightfield;
+	float cellWidth = width / (max(1, (int)maxU) * field.gridWidth);
+	float cellHeight = height / (max(1, (int)maxV) * field.gridHeight);
+	int firstCellX = tileX * field.gridWidth;
+	int firstCellY = tileY * field.gridHeight;
+
+	//both the blocks and the triangles get their corners from these, so that neither can end up a little off from the other
+	auto cellX = [&](int x) { return corner.x + (firstCellX + x) * cellWidth; };
+	auto cellY = [&](int y) { return corner.y - (firstCellY + y) * cellHeight; };
+
+	//the children of a block are visited nearest first, which is why anything behind the closest hit so far gets skipped so often
+	int nearX = ray.direction.x > 0 ? 0 : 1;
+	int nearY = ray.direction.y < 0 ? 0 : 1;
+
+	bool foundHit = false;
+
+	while (stackSize > 0)
+	{
+		Block block = stack[--stackSize];
 
-	if (tymin > tmin)
-		tmin = tymin;
+		int x0 = block.x << block.level;
+		int y0 = block.y << block.level;
+		int x1 = min((block.x + 1) << block.level, field.gridWidth);
+		int y1 = min((block.y + 1) << block.level, field.gridHeight);
 
-	if (tymax < tmax)
-		tmax = tymax;
+		const glm::vec2& bounds = field.getHeightBounds(block.level, block.x, block.y);
+		AABB box(glm::vec3(cellX(x0), cellY(y1), corner.z + bounds[0]), glm::vec3(cellX(x1), cellY(y0), corner.z + bounds[1]));
+		box.pad(epsilon);
 
-	float tzmin = (aabbMin.z - r.origin.z) / r.direction.z;
-	float tzmax = (aabbMax.z - r.origin.z) / r.direction.z;
+		float tEntry;
+		if (!box.intersects(ray.origin, invDirection, hit.distance, tEntry))
+			continue;
 
-	if (tzmin > tzmax) swap(tzmin, tzmax);
+		if (block.level > 0)
+		{
+			int childLevel = block.level - 1;
 
-	if ((tmin > tzmax) || (tzmin > tmax))
-		return false;
+			//pushed farthest first, so that the nearest child is popped first
+			for (int i = 3; i >= 0; i--)
+			{
+				int childX = block.x * 2 + ((i % 2) ^ nearX);
+				int childY = block.y * 2 + ((i / 2) ^ nearY);
 
-	if (tzmin > tmin)
-		tmin = tzmin;
+				if (childX < field.getLevelWidth(childLevel) && childY < field.getLevelHeight(childLevel))
+					stack[stackSize++] = { childLevel, childX, childY };
+			}
 
-	if (tzmax < tmax)
-		tmax = tzmax;
+			continue;
+		}
 
-	return true;
-}
+		//a single cell, made of the same two triangles the displaced surface has always been split into
+		glm::vec3 upperLeft(cellX(x0), cellY(y0), corner.z + field.getHeight(x0, y0));
+		glm::vec3 lowerLeft(cellX(x0), cellY(y0 + 1), corner.z + field.getHeight(x0, y0 + 1));
+		glm::vec3 upperRight(cellX(x0 + 1), cellY(y0), corner.z + field.getHeight(x0 + 1, y0));
+		glm::vec3 lowerRight(cellX(x0 + 1), cellY(y0 + 1), corner.z + field.getHeight(x0 + 1, y0 + 1));
 
-bool DisplacementPlane::intersectsTriangle(const Ray& ray, int numTriangle, glm::vec3& intersectPoint, glm::vec3& intersectNormal)
-{
-	glm::vec3 v1 = heightMesh.verts[heightMesh.triangles[numTriangle].v1];
-	glm::vec3 v2 = heightMesh.verts[heightMesh.triangles[numTriangle].v2];
-	glm::vec3 v3 = heightMesh.verts[heightMesh.triangles[numTriangle].v3];
+		glm::vec3 triangles[2][3] = { { upperLeft, lowerLeft, upperRight }, { upperRight, lowerLeft, lowerRight } };
 
-	glm::vec3 baryCoord, normal;
+		for (auto& triangle : triangles)
+		{
+			glm::vec3 baryCoord, normal;
 
-	//for whatever reason, glm::intersectRayTriangle and glm::intersectLineTriangle wouldn't work, so I had to find my own implementation
-	bool intersectsTriangle = DisplacementPlane::intersectsTriangle(ray, v1, v2, v3, baryCoord, normal);
+			if (!DisplacementPlane::intersectsTriangle(ray, triangle[0], triangle[1], triangle[2], baryCoord, normal))
+				continue;
 
-	if (intersectsTriangle)
-	{
-		intersectPoint.x = baryCoord.x * v1.x + baryCoord.y * v2.x + baryCoord.z * v3.x;
-		intersectPoint.y = baryCoord.x * v1.y + baryCoord.y * v2.y + baryCoord.z * v3.y;
-		intersectPoint.z = baryCoord.x * v1.z + baryCoord.y * v2.z + baryCoord.z * v3.z;
+			glm::vec3 point = baryCoord.x * triangle[0] + baryCoord.y * triangle[1] + baryCoord.z * triangle[2];
+			float distance = glm::distance(ray.origin, point);
 
-		if (glm::distance(ray.origin, intersectPoint) > ray.maxDistance)
-			intersectsTriangle = false;		
+			if (distance < hit.distance)
+			{
+				hit.distance = distance;
+				hit.point = point;
+				hit.normal = normal;
+				hit.triangle[0] = triangle[0];
+				hit.triangle[1] = triangle[1];
+				hit.triangle[2] = triangle[2];
+				foundHit = true;
+
+				if (anyHit)
+					return true;
+			}
+		}
 	}
 
-	return intersectsTriangle;
+	return foundHit;
 }
 
-
 //modified from https://github.com/Jojendersie/gpugi/blob/5d18526c864bbf09baca02bfab6bcec97b7e1210/gpugi/shader/intersectiontests.glsl#L63
 bool DisplacementPlane::intersectsTriangle(Ray ray, glm::vec3 p0, glm::vec3 p1, glm::vec3 p2, glm::vec3& baryCoords, glm::vec3& normal)
 {
@@ -6,12 +6,18 @@ class Plane : public SceneObject
 public:
 	enum class Axis { XY, XZ, YZ };
 
-	Plane() : width(0), height(0), normal(0, 0, 1), axis(Axis::XY), epsilon(.0001), reflective(false), reflectance(0.0) {} //default constructor for Plane
+	Plane() : width(0), height(0), corner(0, 0, 0), normal(0, 0, 1), axis(Axis::XY), epsilon(.0001), reflective(false), reflectance(0.0) {} //default constructor for Plane
 	Plane(glm::vec3 upperLeftCorner, float width, float height, Axis planeAxis, ofColor diffuseColor = ofColor::lightGray, ofColor spectralColor = ofColor::lightGray, bool reflective = false, float reflectance = 0.0);
 
-	virtual void draw() { ofSetColor(getDiffuseColor()); m.draw(); }
+	virtual void draw();
 
-	virtual bool intersects(const Ray& ray, glm::vec3& intersectPoint, glm::vec3& intersectNormal);
+	//hit.uv is the hit's parameterizePoint, which is cheap enough to always work out
+	virtual bool intersects(const Ray& ray, HitRecord& hit);
+	virtual bool occludes(const Ray& ray);
+	virtual int intersectPacket(const RayPacket& packet, int laneMask, float* distances) { return Plane::getShape().quad.intersectPacket(packet, laneMask, distances); }
+	virtual PrimitiveShape getShape();
+	virtual AABB getBounds();
+	virtual RenderStats::PrimitiveType getPrimitiveType() { return RenderStats::PLANE; }
 
 	virtual bool isReflective() { return reflective; }
 	virtual float getReflectance() { return reflectance; }
@@ -26,20 +32,26 @@ public:
 
 	Axis getAxis() { return axis; }
 	
-	glm::vec3 getUpperLeftCorner() { if (m.verts.size() == 0) return glm::vec3(); else return m.verts.at(0); }
+	glm::vec3 getUpperLeftCorner() { return corner; }
+
+	/// <summary>
+	/// Fills in the upper 'left', upper 'right', bottom 'left' and bottom 'right' corners, in that order
+	/// </summary>
+	void getCorners(glm::vec3 corners[4]);
 	
 	//assumes the point is actually on the plane. 
 	glm::vec2 parameterizePoint(const glm::vec3& point);
 
+	friend class SceneSnapshot; //reads and writes baked scene files
 
 protected:
 	float width, height;
 	float epsilon;
 
 private:
+	glm::vec3 corner; //the upper 'left' corner. The other three only get worked out when they're needed
 	glm::vec3 normal;
 	Axis axis;
-	Mesh m;
 
 	bool reflective;
 	float reflectance;
@@ -55,6 +67,9 @@ public:
 
 	virtual bool isReflective() { return true; }
 	virtual float getReflectance() { return reflectance; }
+
+	friend class SceneSnapshot; //reads and writes baked scene files
+
 private:
 	float reflectance;
 };
@@ -64,15 +79,17 @@ class TexturedPlane : public Plane
 public:
 	TexturedPlane() : maxU(0), maxV(0), texture(nullptr) {} //default constructor for TexturedPlane
 	TexturedPlane(glm::vec3 upperLeftCorner, float width, float heigth, Axis planeAxis, float maxU, float maxV,
-		shared_ptr<ofImage> texture);
+		shared_ptr<Texture> texture);
 
-	virtual ofColor getDiffuseColor(const glm::vec3& point);
+	virtual ofColor getDiffuseColor(const HitRecord& hit);
+
+	friend class SceneSnapshot; //reads and writes baked scene files
 
 protected:
 	float maxU, maxV;
 
 private:
-	shared_ptr<ofImage> texture;
+	shared_ptr<Texture> texture;
 
 };
 
@@ -81,49 +98,117 @@ class NormalPlane : public TexturedPlane
 public: 
 	NormalPlane() : TexturedPlane(), normalMap(nullptr) {} //default constructor for NormalPlane
 	NormalPlane(glm::vec3 upperLeftCorner, float width, float heigth, Axis planeAxis, float maxU, float maxV,
-		shared_ptr<ofImage> texture, shared_ptr<ofImage> normalMap);
+		shared_ptr<Texture> texture, shared_ptr<Texture> normalMap);
+
+	virtual bool intersects(const Ray& ray, HitRecord& hit);
+
+	/// <summary>
+	/// Gets the normal at the given (parameterized) point on the plane as seen from the provided ray
+	/// </summary>
+	glm::vec3 getNormalAt(const glm::vec2& uv, const Ray& ray);
+
+	friend class SceneSnapshot; //reads and writes baked scene files
+
+private:
+	shared_ptr<Texture> normalMap;
+};
+
+/// <summary>
+/// The displaced surface of a DisplacementPlane: a grid of cells, one per displacement map texel, each split into two triangles between its corners.
+/// Only one repetition of the map is stored; every repetition of it across the plane reads the same heights. Heightfields never change once they are built,
+/// so planes (and copies of planes) that use the same displacement map and depth share one
+/// </summary>
+struct Heightfield
+{
+	/// <summary>
+	/// Works out the corner heights from the displacement map, scaled by depth, then builds their mipmap. Big maps are split into bands of rows that are built in parallel
+	/// </summary>
+	Heightfield(const Texture& displacementMap, float depth);
+
+	/// <summary>
+	/// Uses heights that were already worked out (by a baked scene file), which must have (gridWidth + 1) x (gridHeight + 1) entries
+	/// </summary>
+	Heightfield(int gridWidth, int gridHeight, vector<float> heights);
+
+	int gridWidth, gridHeight; //the size of the displacement map, in cells
+	vector<float> heights; //the height of every cell corner, (gridWidth + 1) x (gridHeight + 1) of them row by row, already scaled by the displacement depth
 
-	virtual bool intersects(const Ray& ray, glm::vec3& intersectPoint, glm::vec3& intersectNormal);
+	//a min/max mipmap of the heights. Level 0 has the lowest and highest corner of every cell, and each level after that covers 2x2 blocks of the level before it
+	//(rounding up), ending with a single entry for the whole map. All of the levels are stored one after the other, starting at levelOffsets
+	vector<glm::vec2> heightBounds;
+	vector<int> levelOffsets;
+
+	float getHeight(int x, int y) const { return heights[y * (gridWidth + 1) + x]; }
+	int getNumLevels() const { return levelOffsets.size(); }
+	int getLevelWidth(int level) const { return (gridWidth + (1 << level) - 1) >> level; }
+	int getLevelHeight(int level) const { return (gridHeight + (1 << level) - 1) >> level; }
+	const glm::vec2& getHeightBounds(int level, int x, int y) const { return heightBounds[levelOffsets[level] + y * getLevelWidth(level) + x]; }
 
 	/// <summary>
-	/// Gets the normal at a given point on the plane as seen from the provided ray
+	/// Returns the heightfield for the map and depth, building it only if no plane is using one already
 	/// </summary>
-	glm::vec3 getNormalAt(glm::vec3 point, Ray ray);
+	static shared_ptr<const Heightfield> get(shared_ptr<Texture> displacementMap, float depth);
+
 private:
-	shared_ptr<ofImage> normalMap;
+	void buildHeightBounds();
 };
 
 /// <summary>
 /// Represents a plane that has support for displacement mapping
 /// Only works in the XY plane
-/// Currently, the height and width of the displacement map must be a multiple of two. Additionally, the maxU and maxV values must be integers, unlike in other planes
+/// The maxU and maxV values must be integers, unlike in other planes. The displacement map is repeated maxU times across the plane and maxV times down it
 /// </summary>
 class DisplacementPlane : public NormalPlane
 {
 public:
-	DisplacementPlane() : NormalPlane(), displacementDepth(0), displacementMap(nullptr), calculateNormal(true) {} //default constructor for DisplacementPlane
+	DisplacementPlane() : NormalPlane(), displacementDepth(0), displacementMap(nullptr), calculateNormal(true), heightfield(nullptr) {} //default constructor for DisplacementPlane
 
 	DisplacementPlane(glm::vec3 upperLeftCorner, float width, float heigth, Axis planeAxis, int maxU, int maxV,
-		shared_ptr<ofImage> texture, shared_ptr<ofImage> normalMap, shared_ptr<ofImage> displacementMap, float displacementDepth);
+		shared_ptr<Texture> texture, shared_ptr<Texture> normalMap, shared_ptr<Texture> displacementMap, float displacementDepth);
+
+	virtual bool intersects(const Ray& ray, HitRecord& hit);
+	virtual bool occludes(const Ray& ray);
+	virtual AABB getBounds();
+	virtual RenderStats::PrimitiveType getPrimitiveType() { return RenderStats::DISPLACEMENT_PLANE; }
 
-	virtual bool intersects(const Ray& ray, glm::vec3& intersectPoint, glm::vec3& intersectNormal);
-	virtual void draw() { heightMesh.draw(); }
+	//drawing every cell would be far too slow for the preview, so only the flat plane is drawn
+	virtual void draw() { Plane::draw(); }
+
+	//the displaced surface isn't flat, so the plane's shape doesn't apply
+	virtual int intersectPacket(const RayPacket& packet, int laneMask, float* distances) { return SceneObject::intersectPacket(packet, laneMask, distances); }
+	virtual PrimitiveShape getShape() { return PrimitiveShape(); }
+
+	/// <summary>
+	/// Intersects a ray with the triangle p0, p1, p2, which every intersection test against the displaced surface comes down to.
+	/// baryCoords gets the barycentric coordinates of the hit and normal the (unnormalized) normal of the triangle
+	/// </summary>
+	static bool intersectsTriangle(Ray ray, glm::vec3 p0, glm::vec3 p1, glm::vec3 p2, glm::vec3& baryCoords, glm::vec3& normal);
+
+	friend class SceneSnapshot; //reads and writes baked scene files
 
 private:
-	shared_ptr<ofImage> displacementMap;
+	shared_ptr<Texture> displacementMap;
 	float displacementDepth;
 	bool calculateNormal;
 
-	Mesh heightMesh;
-	void addDisplacementToMesh();
-	void iterateOverDisplacementMap(float pixelWidth, float pixelHeight, float baseX, float baseZ, int& numVerts, glm::vec3& UL, glm::vec3& LL, glm::vec3& UR, glm::vec3& LR);
+	shared_ptr<const Heightfield> heightfield; //nullptr if there is no displacement map
 
-	glm::vec3 aabbMin;
-	glm::vec3 aabbMax;
-	void calculateBoundingBox();
+	struct HeightfieldHit
+	{
+		float distance;
+		glm::vec3 point;
+		glm::vec3 triangle[3];
+		glm::vec3 normal; //the unnormalized normal of the triangle
+	};
 
-	bool intersectsBoundingBox(const Ray& r);
-	bool intersectsTriangle(const Ray& ray, int numTriangle, glm::vec3& intersectPoint, glm::vec3& intersectNormal);
-	static bool intersectsTriangle(Ray ray, glm::vec3 p0, glm::vec3 p1, glm::vec3 p2, glm::vec3& baryCoords, glm::vec3& normal);
+	/// <summary>
+	/// Finds the closest hit on the displaced surface in front of ray.maxDistance, or (if anyHit is set) the first one found
+	/// </summary>
+	bool intersectHeightfield(const Ray& ray, bool anyHit, HeightfieldHit& hit);
 
+	/// <summary>
+	/// Walks the min/max mipmap of one repetition of the map (tileX across and tileY down) from the top, skipping every block the ray passes above or below
+	/// and only testing the triangles of the cells it actually reaches
+	/// </summary>
+	bool intersectTile(const Ray& ray, const glm::vec3& invDirection, int tileX, int tileY, bool anyHit, HeightfieldHit& hit);
 };
\ No newline at end of file
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "GraphicalStructs.h"
+#include "RayPacket.h"
+
+/**
+ * Plain data copies of the shapes that most scenes are made of, which the BVH stores right in its leaves so that it can intersect them
+ * without a virtual call or a trip through a shared_ptr. Sphere and Plane use these for their own intersection tests too,
+ * so the BVH finds exactly the same hits as it would by asking the objects themselves
+ */
+
+struct SphereShape
+{
+	float center[3];
+	float radiusSquared;
+
+	//distance is measured from the ray's origin to the hit point, which is how the BVH compares hits
+	bool intersects(const Ray& ray, glm::vec3& point, float& distance) const
+	{
+		float t;
+		if (!glm::intersectRaySphere(ray.origin, ray.direction, getCenter(), radiusSquared, t))
+			return false;
+
+		point = ray.origin + ray.direction * t;
+		distance = glm::distance(point, ray.origin);
+
+		return distance <= ray.maxDistance;
+	}
+
+	bool occludes(const Ray& ray) const
+	{
+		float distance;
+		return glm::intersectRaySphere(ray.origin, ray.direction, getCenter(), radiusSquared, distance) && distance <= ray.maxDistance;
+	}
+
+	/// <summary>
+	/// Tests every lane of the packet at once (see SceneObject::intersectPacket)
+	/// </summary>
+	int intersectPacket(const RayPacket& packet, int laneMask, float* distances) const
+	{
+		//the same steps as glm::intersectRaySphere, done for every lane at once
+		const simd::Floats epsilon = simd::set(std::numeric_limits<float>::epsilon());
+		const simd::Floats rSquared = simd::set(radiusSquared);
+
+		simd::Floats t0 = simd::set(0);
+		simd::Floats diffLengthSquared = simd::set(0);
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			simd::Floats diff = simd::sub(simd::set(center[axis]), simd::load(packet.origin[axis]));
+
+			t0 = simd::add(t0, simd::mul(diff, simd::load(packet.direction[axis])));
+			diffLengthSquared = simd::add(diffLengthSquared, simd::mul(diff, diff));
+		}
+
+		simd::Floats dSquared = simd::sub(diffLengthSquared, simd::mul(t0, t0));
+
+		//lanes that miss would take the square root of a negative number here, but they are masked out below
+		simd::Floats t1 = simd::sqrt(simd::max(simd::sub(rSquared, dSquared), simd::set(0)));
+		simd::Floats distance = simd::select(simd::greater(t0, simd::add(t1, epsilon)), simd::sub(t0, t1), simd::add(t0, t1));
+
+		simd::Floats hit = simd::maskAnd(simd::lessEqual(dSquared, rSquared), simd::maskAnd(simd::greater(distance, epsilon), simd::lessEqual(distance, simd::load(packet.maxDistance))));
+
+		simd::store(distances, distance);
+		return simd::moveMask(hit) & laneMask;
+	}
+
+	glm::vec3 getCenter() const { return glm::vec3(center[0], center[1], center[2]); }
+};
+
+//a finite, axis aligned plane
+struct QuadShape
+{
+	//the plane sits at coordinate along normalAxis, and a point on it is inside the quad if its coordinates along uAxis and vAxis are inside [uMin, uMax] and [vMin, vMax]
+	int normalAxis, uAxis, vAxis;
+	float coordinate;
+	float uMin, uMax;
+	float vMin, vMax;
+
+	bool intersects(const Ray& ray, glm::vec3& point, float& distance) const
+	{
+		//this is what glm::intersectRayPlane works out to for an axis aligned normal. Flipping the normal to face the ray (like Plane::intersects does) doesn't change the distance
+		float directionAlongNormal = ray.direction[normalAxis];
+		if (fabs(directionAlongNormal) <= std::numeric_limits<float>::epsilon())
+			return false;
+
+		float t = (coordinate - ray.origin[normalAxis]) / directionAlongNormal;
+		if (!(t > 0) || t > ray.maxDistance)
+			return false;
+
+		point = ray.origin + t * ray.direction;
+		if (!(point[uAxis] >= uMin && point[uAxis] <= uMax && point[vAxis] >= vMin && point[vAxis] <= vMax))
+			return false;
+
+		distance = glm::distance(point, ray.origin);
+		return true;
+	}
+
+	bool occludes(const Ray& ray) const { glm::vec3 point; float distance; return intersects(ray, point, distance); }
+
+	/// <summary>
+	/// Tests every lane of the packet at once (see SceneObject::intersectPacket)
+	/// </summary>
+	int intersectPacket(const RayPacket& packet, int laneMask, float* distances) const
+	{
+		simd::Floats directionAlongNormal = simd::load(packet.direction[normalAxis]);
+		simd::Floats distance = simd::div(simd::sub(simd::set(coordinate), simd::load(packet.origin[normalAxis])), directionAlongNormal);
+
+		simd::Floats hit = simd::maskAnd(simd::greater(simd::abs(directionAlongNormal), simd::set(std::numeric_limits<float>::epsilon())),
+			simd::maskAnd(simd::greater(distance, simd::set(0)), simd::lessEqual(distance, simd::load(packet.maxDistance))));
+
+		simd::Floats u = simd::add(simd::load(packet.origin[uAxis]), simd::mul(distance, simd::load(packet.direction[uAxis])));
+		simd::Floats v = simd::add(simd::load(packet.origin[vAxis]), simd::mul(distance, simd::load(packet.direction[vAxis])));
+
+		hit = simd::maskAnd(hit, simd::maskAnd(simd::greaterEqual(u, simd::set(uMin)), simd::lessEqual(u, simd::set(uMax))));
+		hit = simd::maskAnd(hit, simd::maskAnd(simd::greaterEqual(v, simd::set(vMin)), simd::lessEqual(v, simd::set(vMax))));
+
+		simd::store(distances, distance);
+		return simd::moveMask(hit) & laneMask;
+	}
+};
+
+/// <summary>
+/// A tagged union of the shapes above. Objects that aren't one of them (or whose intersects() does something the plain shape doesn't) use NONE,
+/// and are intersected through their virtual functions instead
+/// </summary>
+struct PrimitiveShape
+{
+	enum class Type : int { NONE, SPHERE, QUAD };
+
+	PrimitiveShape() : type(Type::NONE) {}
+
+	Type type;
+
+	union
+	{
+		SphereShape sphere;
+		QuadShape quad;
+	};
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "GraphicalStructs.h"
+#include "Simd.h"
+
+/// <summary>
+/// A group of rays that are traced together, stored as a structure of arrays so that each coordinate of every ray can be loaded into one SIMD register.
+/// The packet holds one ray per SIMD lane. activeLanes has a bit set for every lane that holds a ray; the other lanes are left zeroed and
+/// are masked out of every result
+/// </summary>
+struct RayPacket
+{
+	static const int SIZE = simd::WIDTH;
+
+	RayPacket() : activeLanes(0)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			for (int lane = 0; lane < SIZE; lane++)
+			{
+				origin[axis][lane] = 0;
+				direction[axis][lane] = 0;
+				invDirection[axis][lane] = 0;
+			}
+		}
+
+		for (int lane = 0; lane < SIZE; lane++)
+			maxDistance[lane] = 0;
+	}
+
+	void setRay(int lane, const Ray& ray)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			origin[axis][lane] = ray.origin[axis];
+			direction[axis][lane] = ray.direction[axis];
+			invDirection[axis][lane] = ray.invDirection[axis];
+		}
+
+		maxDistance[lane] = ray.maxDistance;
+		activeLanes |= 1 << lane;
+	}
+
+	Ray getRay(int lane) const
+	{
+		return Ray(glm::vec3(origin[0][lane], origin[1][lane], origin[2][lane]), glm::vec3(direction[0][lane], direction[1][lane], direction[2][lane]), maxDistance[lane]);
+	}
+
+	bool isActive(int lane) const { return (activeLanes >> lane) & 1; }
+
+	/// <summary>
+	/// The packet version of AABB::intersects. Returns a mask of the lanes in laneMask whose rays hit the box no further than maxDistances (one per lane) along the ray
+	/// </summary>
+	int intersects(const AABB& box, const float* maxDistances, int laneMask) const
+	{
+		simd::Floats tNear = simd::set(-std::numeric_limits<float>::infinity());
+		simd::Floats tFar = simd::set(std::numeric_limits<float>::infinity());
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			simd::Floats rayOrigin = simd::load(origin[axis]);
+			simd::Floats rayInvDirection = simd::load(invDirection[axis]);
+
+			simd::Floats t1 = simd::mul(simd::sub(simd::set(box.minCorner[axis]), rayOrigin), rayInvDirection);
+			simd::Floats t2 = simd::mul(simd::sub(simd::set(box.maxCorner[axis]), rayOrigin), rayInvDirection);
+
+			tNear = simd::max(tNear, simd::min(t1, t2));
+			tFar = simd::min(tFar, simd::max(t1, t2));
+		}
+
+		simd::Floats hit = simd::maskAnd(simd::lessEqual(tNear, tFar), simd::maskAnd(simd::greaterEqual(tFar, simd::set(0)), simd::lessEqual(tNear, simd::load(maxDistances))));
+		return simd::moveMask(hit) & laneMask;
+	}
+
+	alignas(32) float origin[3][SIZE];
+	alignas(32) float direction[3][SIZE];
+	alignas(32) float invDirection[3][SIZE];
+	alignas(32) float maxDistance[SIZE];
+	int activeLanes;
+};
@@ -0,0 +1,188 @@
+#include "RenderCheckpoint.h"
+#include <cstdio>
+
+//--------------------------------------------------------------
+
+namespace
+{
+	const char MAGIC[8] = { 'M', 'O', 'O', 'N', 'C', 'K', 'P', 'T' };
+	const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+	struct CheckpointHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t byteOrderMark;
+		uint64_t renderKey;
+		uint32_t width;
+		uint32_t height;
+		uint32_t numTiles;
+		uint32_t numChannels;
+	};
+}
+
+RenderCheckpoint::RenderCheckpoint(const string& path, uint64_t renderKey, const vector<Tile>& tiles, ofPixels& pixels)
+	: path(path), renderKey(renderKey), tiles(tiles), pixels(pixels), done(tiles.size(), 0)
+{ }
+
+void RenderCheckpoint::markDone(int tileIndex)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	done[tileIndex] = 1;
+}
+
+bool RenderCheckpoint::isDone(int tileIndex)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return done[tileIndex] != 0;
+}
+
+//the rows of a tile's pixels are written and read one after another, from the top of the tile down
+static size_t getTileRowBytes(const Tile& tile, const ofPixels& pixels) { return tile.width * pixels.getNumChannels(); }
+
+static unsigned char* getTileRow(const Tile& tile, ofPixels& pixels, int row)
+{
+	return pixels.getData() + ((size_t)(tile.y + row) * pixels.getWidth() + tile.x) * pixels.getNumChannels();
+}
+
+int RenderCheckpoint::resume()
+{
+	ifstream in(path, ios::binary);
+	if (!in)
+		return 0;
+
+	CheckpointHeader header;
+	in.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+	if (!in || memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || header.byteOrderMark != BYTE_ORDER_MARK)
+	{
+		ofLogWarning("RenderCheckpoint") << path << " isn't a checkpoint from this build, so the render starts over";
+		return 0;
+	}
+
+	if (header.renderKey != renderKey || header.width != pixels.getWidth() || header.height != pixels.getHeight()
+		|| header.numTiles != tiles.size() || header.numChannels != pixels.getNumChannels())
+	{
+		ofLogWarning("RenderCheckpoint") << path << " was saved by a different render, so the render starts over";
+		return 0;
+	}
+
+	vector<char> savedDone(tiles.size());
+	in.read(savedDone.data(), savedDone.size());
+
+	int numResumed = 0;
+
+	for (size_t i = 0; i < tiles.size() && in; i++)
+	{
+		if (!savedDone[i])
+			continue;
+
+		for (int row = 0; row < tiles[i].height; row++)
+			in.read(reinterpret_cast<char*>(getTileRow(tiles[i], pixels, row)), getTileRowBytes(tiles[i], pixels));
+
+		//a tile cut off by the end of the file is rendered again
+		if (in)
+		{
+			markDone(i);
+			numResumed++;
+		}
+	}
+
+	return numResumed;
+}
+
+bool RenderCheckpoint::save()
+{
+	vector<char> savedDone;
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		savedDone = done;
+	}
+
+	//written next to the checkpoint and then moved over it, so the old checkpoint is never half overwritten
+	string tempPath = path + ".tmp";
+
+	{
+		ofstream out(tempPath, ios::binary | ios::trunc);
+
+		CheckpointHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = VERSION;
+		header.byteOrderMark = BYTE_ORDER_MARK;
+		header.renderKey = renderKey;
+		header.width = pixels.getWidth();
+		header.height = pixels.getHeight();
+		header.numTiles = tiles.size();
+		header.numChannels = pixels.getNumChannels();
+
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(savedDone.data(), savedDone.size());
+
+		//finished tiles are never written to again, so they can be read while the render threads carry on with the others
+		for (size_t i = 0; i < tiles.size(); i++)
+		{
+			if (!savedDone[i])
+				continue;
+
+			for (int row = 0; row < tiles[i].height; row++)
+				out.write(reinterpret_cast<const char*>(getTileRow(tiles[i], pixels, row)), getTileRowBytes(tiles[i], pixels));
+		}
+
+		out.close();
+
+		if (!out)
+		{
+			ofLogError("RenderCheckpoint") << "couldn't write " << tempPath;
+			std::remove(tempPath.c_str());
+			return false;
+		}
+	}
+
+	//rename replaces the old file in one step everywhere but Windows, which won't rename over an existing file
+	if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+	{
+		std::remove(path.c_str());
+
+		if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+		{
+			ofLogError("RenderCheckpoint") << "couldn't replace " << path;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void RenderCheckpoint::startSaving(float intervalSeconds)
+{
+	stopSaving(false);
+	stopping = false;
+
+	saveThread = std::thread([this, intervalSeconds]()
+	{
+		std::unique_lock<std::mutex> guard(saveLock);
+
+		//wait_for returns true once stopping is set, and false every time the interval is up
+		while (!stopRequested.wait_for(guard, std::chrono::duration<float>(intervalSeconds), [this]() { return stopping; }))
+			save();
+	});
+}
+
+void RenderCheckpoint::stopSaving(bool finalSave)
+{
+	if (saveThread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> guard(saveLock);
+			stopping = true;
+		}
+
+		stopRequested.notify_all();
+		saveThread.join();
+	}
+
+	if (finalSave)
+		save();
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Renderer.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * Saves the tiles of a render that are finished to a file every so often, so that a render that is interrupted (by a crash, or by the machine being taken away)
+ * can pick up where it left off instead of starting over. A tile's pixels are final once it's done, so the finished tiles are all there is to save;
+ * tiles that were partway done are rendered again from the start.
+ * A checkpoint only resumes the render it was saved by: the same image size, tiles, camera, render settings, object bounds and colors, and lights,
+ * which are checked with a key (see Renderer). Like snapshots, checkpoints use the machine's native byte order and are only read by the same build
+ */
+class RenderCheckpoint
+{
+public:
+	/// <summary>
+	/// tiles are the tiles of the whole render, in the order they are numbered in, and pixels is the image they're rendered into.
+	/// Both have to stay alive and unchanged (other than the rendering of unfinished tiles) until this is destroyed
+	/// </summary>
+	RenderCheckpoint(const string& path, uint64_t renderKey, const vector<Tile>& tiles, ofPixels& pixels);
+	~RenderCheckpoint() { stopSaving(false); }
+
+	RenderCheckpoint(const RenderCheckpoint&) = delete;
+	RenderCheckpoint& operator=(const RenderCheckpoint&) = delete;
+
+	/// <summary>
+	/// Copies the tiles finished by an earlier attempt at the same render into pixels and marks them done, returning how many there were.
+	/// Returns 0 if there's no checkpoint file, or it's for a different render
+	/// </summary>
+	int resume();
+
+	/// <summary>
+	/// Starts saving the checkpoint on its own thread every intervalSeconds, while the tiles are rendered
+	/// </summary>
+	void startSaving(float intervalSeconds);
+
+	/// <summary>
+	/// Stops saving, saving one last time first if finalSave is set
+	/// </summary>
+	void stopSaving(bool finalSave);
+
+	//called by the render threads, once every pixel of the tile has been written
+	void markDone(int tileIndex);
+	bool isDone(int tileIndex);
+
+	/// <summary>
+	/// Writes every finished tile to the checkpoint file. The file is replaced all at once, so an interruption while saving leaves the last checkpoint as it was
+	/// </summary>
+	bool save();
+
+private:
+	static const uint32_t VERSION = 1;
+
+	string path;
+	uint64_t renderKey;
+	const vector<Tile>& tiles;
+	ofPixels& pixels;
+
+	std::mutex lock; //guards done
+	vector<char> done; //one flag per tile
+
+	std::thread saveThread;
+	std::mutex saveLock; //guards stopping
+	std::condition_variable stopRequested;
+	bool stopping = false;
+};
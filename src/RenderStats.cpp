@@ -0,0 +1,86 @@
+#include "RenderStats.h"
+#include <fstream>
+
+//--------------------------------------------------------------
+
+void RenderStats::merge(const RenderStats& other)
+{
+	primaryRays += other.primaryRays;
+	shadowRays += other.shadowRays;
+	shadowCacheHits += other.shadowCacheHits;
+	reflectionRays += other.reflectionRays;
+	skippedReflections += other.skippedReflections;
+
+	nodeTests += other.nodeTests;
+
+	for (int type = 0; type < NUM_PRIMITIVE_TYPES; type++)
+	{
+		intersectionTests[type] += other.intersectionTests[type];
+		intersectionHits[type] += other.intersectionHits[type];
+	}
+
+	textureSamples += other.textureSamples;
+	irradianceCacheHits += other.irradianceCacheHits;
+	maxDepth = max(maxDepth, other.maxDepth);
+}
+
+string RenderStats::toJson() const
+{
+	static const char* PRIMITIVE_NAMES[NUM_PRIMITIVE_TYPES] = { "sphere", "plane", "displacementPlane", "box", "instance" };
+
+	//every value is a number and every key is fixed, so nothing needs escaping
+	ostringstream json;
+	json << "{\n";
+	json << "  \"width\": " << width << ",\n";
+	json << "  \"height\": " << height << ",\n";
+	json << "  \"threads\": " << numThreads << ",\n";
+	json << "  \"milliseconds\": " << milliseconds << ",\n";
+	json << "  \"rays\": {\n";
+	json << "    \"primary\": " << primaryRays << ",\n";
+	json << "    \"shadow\": " << shadowRays << ",\n";
+	json << "    \"shadowCacheHit\": " << shadowCacheHits << ",\n";
+	json << "    \"reflection\": " << reflectionRays << ",\n";
+	json << "    \"skippedReflection\": " << skippedReflections << "\n";
+	json << "  },\n";
+	json << "  \"bvhNodeTests\": " << nodeTests << ",\n";
+	json << "  \"intersections\": {\n";
+
+	for (int type = 0; type < NUM_PRIMITIVE_TYPES; type++)
+	{
+		json << "    \"" << PRIMITIVE_NAMES[type] << "\": { \"tests\": " << intersectionTests[type] << ", \"hits\": " << intersectionHits[type] << " }";
+		json << (type + 1 < NUM_PRIMITIVE_TYPES ? ",\n" : "\n");
+	}
+
+	json << "  },\n";
+	json << "  \"textureSamples\": " << textureSamples << ",\n";
+	json << "  \"irradianceCacheHits\": " << irradianceCacheHits << ",\n";
+	json << "  \"maxRecursionDepth\": " << maxDepth << "\n";
+	json << "}\n";
+
+	return json.str();
+}
+
+bool RenderStats::saveJson(const string& path) const
+{
+	ofstream out(ofToDataPath(path, true));
+	out << toJson();
+
+	return out.good();
+}
+
+string RenderStats::pathForImage(const string& imagePath)
+{
+	return imagePath.substr(0, findExtension(imagePath)) + ".stats.json";
+}
+
+size_t RenderStats::findExtension(const string& path)
+{
+	//only a dot after the last path separator starts an extension
+	size_t nameStart = path.find_last_of("/\\");
+	size_t dot = path.find_last_of('.');
+
+	if (dot == string::npos || (nameStart != string::npos && dot < nameStart))
+		return path.size();
+
+	return dot;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "ofMain.h"
+
+/// <summary>
+/// Counts what a render spends its time on. Every render thread counts into its own RenderStats (the one current() points to), so nothing is shared
+/// or locked while tracing; Renderer merges them once the threads are done. Code that runs outside of a render (current() is nullptr) isn't counted
+/// </summary>
+struct RenderStats
+{
+	//intersection tests are counted by the kind of object that was tested (see SceneObject::getPrimitiveType), however it was tested.
+	//Every sort of sphere is a SPHERE and every flat plane a PLANE, and an INSTANCE is counted once for the test of its transformed object
+	enum PrimitiveType { SPHERE, PLANE, DISPLACEMENT_PLANE, BOX, INSTANCE, NUM_PRIMITIVE_TYPES };
+
+	uint64_t primaryRays = 0;
+	uint64_t shadowRays = 0;
+	uint64_t shadowCacheHits = 0; //shadow rays that were blocked by the object that blocked the last shadow ray to the same light, so the BVH wasn't searched
+	uint64_t reflectionRays = 0;
+	uint64_t skippedReflections = 0; //reflections that weren't traced because of the scene's ReflectionLimits
+
+	uint64_t nodeTests = 0; //ray-box tests against BVH nodes
+	uint64_t intersectionTests[NUM_PRIMITIVE_TYPES] = {};
+	uint64_t intersectionHits[NUM_PRIMITIVE_TYPES] = {};
+
+	uint64_t textureSamples = 0;
+	uint64_t irradianceCacheHits = 0; //hits whose diffuse lighting was interpolated from the irradiance cache instead of being worked out with shadow rays
+
+	int maxDepth = 0; //the most reflections any primary ray went through
+	int depth = 0; //how many reflections deep the ray being traced right now is
+
+	//filled in by Renderer for the merged totals
+	int numThreads = 0;
+	int width = 0;
+	int height = 0;
+	long long milliseconds = 0;
+
+	void countTest(PrimitiveType type, bool hit)
+	{
+		intersectionTests[type]++;
+		intersectionHits[type] += hit;
+	}
+
+	void enterReflection()
+	{
+		reflectionRays++;
+		depth++;
+		maxDepth = max(maxDepth, depth);
+	}
+
+	void leaveReflection() { depth--; }
+
+	/// <summary>
+	/// Adds another thread's counters to these ones
+	/// </summary>
+	void merge(const RenderStats& other);
+
+	string toJson() const;
+
+	/// <summary>
+	/// Writes toJson() to path, returning false if the file couldn't be written
+	/// </summary>
+	bool saveJson(const string& path) const;
+
+	/// <summary>
+	/// Where the statistics for an image saved at imagePath go: the same name with the extension replaced by .stats.json
+	/// </summary>
+	static string pathForImage(const string& imagePath);
+
+	/// <summary>
+	/// Where path's extension starts (at its dot), or path.size() if it doesn't have one
+	/// </summary>
+	static size_t findExtension(const string& path);
+
+	/// <summary>
+	/// The counters of the render thread that is calling this, or nullptr if it isn't a render thread
+	/// </summary>
+	static RenderStats* current() { return threadStats; }
+	static void setCurrent(RenderStats* stats) { threadStats = stats; }
+
+private:
+	static inline thread_local RenderStats* threadStats = nullptr;
+};
@@ -0,0 +1,582 @@
+#include "Renderer.h"
+#include "RenderCheckpoint.h"
+#include <atomic>
+#include <chrono>
+
+//--------------------------------------------------------------
+
+int RenderSettings::getNumThreads() const
+{
+	if (numThreads > 0)
+		return numThreads;
+
+	//hardware_concurrency is allowed to return 0 if it can't tell how many cores there are
+	return max(1, (int)std::thread::hardware_concurrency());
+}
+
+//--------------------------------------------------------------
+
+void WorkStealingScheduler::run(int numJobs, const std::function<void(int, int)>& work)
+{
+	vector<JobQueue> queues(numThreads);
+
+	//each thread starts off with a contiguous run of jobs so that neighboring jobs are processed by the same thread
+	for (int i = 0; i < numJobs; i++)
+		queues[(long long)i * numThreads / numJobs].jobs.push_back(i);
+
+	vector<std::thread> threads;
+
+	for (int threadIndex = 0; threadIndex < numThreads; threadIndex++)
+	{
+		threads.emplace_back([this, &queues, &work, threadIndex]()
+		{
+			int job;
+			while (popJob(queues, threadIndex, job))
+				work(job, threadIndex);
+		});
+	}
+
+	for (std::thread& t : threads)
+		t.join();
+}
+
+bool WorkStealingScheduler::popJob(vector<JobQueue>& queues, int threadIndex, int& job)
+{
+	//first try to take the next job from our own queue
+	{
+		JobQueue& own = queues[threadIndex];
+		std::lock_guard<std::mutex> guard(own.lock);
+
+		if (!own.jobs.empty())
+		{
+			job = own.jobs.front();
+			own.jobs.pop_front();
+			return true;
+		}
+	}
+
+	//if we're out of work, steal from the back of someone else's queue (the back is the work they'd get to last)
+	for (int i = 1; i < numThreads; i++)
+	{
+		JobQueue& victim = queues[(threadIndex + i) % numThreads];
+		std::lock_guard<std::mutex> guard(victim.lock);
+
+		if (!victim.jobs.empty())
+		{
+			job = victim.jobs.back();
+			victim.jobs.pop_back();
+			return true;
+		}
+	}
+
+	//no new jobs are ever added, so if every queue is empty we are done
+	return false;
+}
+
+//--------------------------------------------------------------
+
+//interleaves the bits of x and y so that sorting by the result walks the tiles along a Z-order curve
+static unsigned int mortonCode(unsigned int x, unsigned int y)
+{
+	unsigned int code = 0;
+
+	for (int bit = 0; bit < 16; bit++)
+	{
+		code |= ((x >> bit) & 1) << (2 * bit);
+		code |= ((y >> bit) & 1) << (2 * bit + 1);
+	}
+
+	return code;
+}
+
+vector<Tile> Renderer::makeTiles(int width, int height, int tileSize, RenderSettings::TileOrder order)
+{
+	tileSize = max(1, tileSize);
+
+	vector<Tile> tiles;
+
+	//tiles are generated in row-major order, which is also the order ofPixels stores its rows in
+	for (int y = 0; y < height; y += tileSize)
+	{
+		for (int x = 0; x < width; x += tileSize)
+			tiles.push_back(Tile(x, y, min(tileSize, width - x), min(tileSize, height - y)));
+	}
+
+	if (order == RenderSettings::TileOrder::MORTON)
+	{
+		std::stable_sort(tiles.begin(), tiles.end(), [tileSize](const Tile& a, const Tile& b)
+		{
+			return mortonCode(a.x / tileSize, a.y / tileSize) < mortonCode(b.x / tileSize, b.y / tileSize);
+		});
+	}
+
+	return tiles;
+}
+
+void Renderer::resetStats(int width, int height)
+{
+	stats = RenderStats();
+	stats.numThreads = settings.getNumThreads();
+	stats.width = width;
+	stats.height = height;
+}
+
+ofPixels Renderer::render(const PinholeCamera& camera)
+{
+	auto t1 = std::chrono::high_resolution_clock::now();
+
+	//this has to happen before the threads start since it modifies the scene
+	scene.finalize();
+	scene.setReflectionLimits(settings.reflectionLimits);
+	scene.setIrradianceCacheSettings(settings.irradianceCache);
+	resetStats(camera.width, camera.height);
+
+	ofPixels pixels;
+	pixels.allocate(camera.width, camera.height, OF_IMAGE_COLOR);
+
+	vector<Tile> tiles = makeTiles(camera.width, camera.height, settings.tileSize, settings.tileOrder);
+
+	//tiles finished by an earlier attempt at this render are loaded instead of being traced again
+	unique_ptr<RenderCheckpoint> checkpoint;
+
+	if (!settings.checkpointPath.empty())
+	{
+		checkpoint = make_unique<RenderCheckpoint>(settings.checkpointPath, getCheckpointKey(camera), tiles, pixels);
+
+		int numResumed = checkpoint->resume();
+		if (numResumed > 0)
+			cout << "Resuming from " << settings.checkpointPath << ", which already has " << numResumed << " of " << tiles.size() << " tiles" << endl;
+
+		checkpoint->startSaving(settings.checkpointInterval);
+	}
+
+	renderPass(tiles, camera, pixels, Tile(0, 0, camera.width, camera.height), 1, 0, nullptr, checkpoint.get());
+
+	//the finished image is saved too, in case the process stops before whatever called this saves it
+	if (checkpoint != nullptr)
+		checkpoint->stopSaving(true);
+
+	auto t2 = std::chrono::high_resolution_clock::now();
+	auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+	stats.milliseconds = duration;
+
+	if (settings.printProgress)
+		cout << "Ray tracing took " << duration << " milliseconds using " << settings.getNumThreads() << " threads" << endl;
+
+	return pixels;
+}
+
+//FNV-1a over the bytes of a value, added to the hash so far
+template<typename T>
+static void hashValue(uint64_t& hash, const T& value)
+{
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+
+	for (size_t i = 0; i < sizeof(T); i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+}
+
+static void hashValue(uint64_t& hash, const glm::vec3& value)
+{
+	hashValue(hash, value.x);
+	hashValue(hash, value.y);
+	hashValue(hash, value.z);
+}
+
+static void hashValue(uint64_t& hash, const ofColor& value)
+{
+	hashValue(hash, value.r);
+	hashValue(hash, value.g);
+	hashValue(hash, value.b);
+	hashValue(hash, value.a);
+}
+
+uint64_t Renderer::getCheckpointKey(const PinholeCamera& camera) const
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+
+	//each field is hashed on its own, since the padding between the fields of a struct isn't guaranteed to be the same
+	hashValue(hash, camera.position);
+	hashValue(hash, camera.forward);
+	hashValue(hash, camera.right);
+	hashValue(hash, camera.up);
+	hashValue(hash, camera.width);
+	hashValue(hash, camera.height);
+
+	hashValue(hash, settings.tileSize);
+	hashValue(hash, settings.tileOrder);
+	hashValue(hash, settings.usePacketTracing);
+	hashValue(hash, settings.minSamples);
+	hashValue(hash, settings.maxSamples);
+	hashValue(hash, settings.aaThreshold);
+
+	hashValue(hash, settings.reflectionLimits.maxDepth);
+	hashValue(hash, settings.reflectionLimits.minWeight);
+	hashValue(hash, settings.reflectionLimits.russianRoulette);
+	hashValue(hash, settings.reflectionLimits.rouletteWeight);
+
+	hashValue(hash, settings.irradianceCache.enabled);
+	hashValue(hash, settings.irradianceCache.spacing);
+	hashValue(hash, settings.irradianceCache.maxError);
+
+	//there's no cheap way to tell two scenes apart completely (textures aren't looked at), but where every object and light is and how bright
+	//and what color they are catches loading the wrong scene or changing it, and is nothing next to the render
+	hashValue(hash, scene.getNumObjects());
+	hashValue(hash, scene.getNumLights());
+
+	for (int i = 0; i < scene.getNumObjects(); i++)
+	{
+		SceneObject& object = *scene.getObject(i);
+		AABB bounds = object.getBounds();
+
+		hashValue(hash, bounds.minCorner);
+		hashValue(hash, bounds.maxCorner);
+		hashValue(hash, object.getDiffuseColor());
+		hashValue(hash, object.getSpectralColor());
+		hashValue(hash, object.getReflectance());
+	}
+
+	for (int i = 0; i < scene.getNumLights(); i++)
+	{
+		Light& light = *scene.getLight(i);
+
+		hashValue(hash, light.getOrigin());
+		hashValue(hash, light.getLuminosity());
+
+		if (Spotlight* spotlight = dynamic_cast<Spotlight*>(&light))
+		{
+			hashValue(hash, spotlight->getDirection());
+			hashValue(hash, spotlight->getConeAngle());
+		}
+	}
+
+	return hash;
+}
+
+ofPixels Renderer::renderRegion(const PinholeCamera& camera, const Tile& region)
+{
+	auto t1 = std::chrono::high_resolution_clock::now();
+
+	scene.finalize();
+	scene.setReflectionLimits(settings.reflectionLimits);
+	scene.setIrradianceCacheSettings(settings.irradianceCache);
+	resetStats(region.width, region.height);
+
+	ofPixels pixels;
+	pixels.allocate(region.width, region.height, OF_IMAGE_COLOR);
+
+	//the same tiles a full render would have inside the region, as long as it starts on a tile boundary
+	vector<Tile> tiles = makeTiles(region.width, region.height, settings.tileSize, settings.tileOrder);
+	for (Tile& tile : tiles)
+	{
+		tile.x += region.x;
+		tile.y += region.y;
+	}
+
+	renderPass(tiles, camera, pixels, region, 1, 0, nullptr);
+
+	auto t2 = std::chrono::high_resolution_clock::now();
+	stats.milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+
+	return pixels;
+}
+
+ofPixels Renderer::renderProgressive(const PinholeCamera& camera, const std::function<void(const ofPixels&, int, int)>& passDone, const std::atomic<bool>* cancel)
+{
+	auto t1 = std::chrono::high_resolution_clock::now();
+
+	scene.finalize();
+	scene.setReflectionLimits(settings.reflectionLimits);
+	scene.setIrradianceCacheSettings(settings.irradianceCache);
+	resetStats(camera.width, camera.height);
+
+	ofPixels pixels;
+	pixels.allocate(camera.width, camera.height, OF_IMAGE_COLOR);
+	pixels.setColor(ofColor::black);
+
+	//every pass's grid has to contain the previous pass's grid, which is why the block size is kept to a power of two
+	int firstBlockSize = 1;
+	while (firstBlockSize * 2 <= settings.previewBlockSize)
+		firstBlockSize *= 2;
+
+	int numPasses = 1;
+	for (int blockSize = firstBlockSize; blockSize > 1; blockSize /= 2)
+		numPasses++;
+
+	vector<Tile> tiles = makeTiles(camera.width, camera.height, settings.tileSize, settings.tileOrder);
+
+	int pass = 0;
+	for (int blockSize = firstBlockSize; blockSize >= 1; blockSize /= 2, pass++)
+	{
+		int previousBlockSize = pass == 0 ? 0 : blockSize * 2;
+		renderPass(tiles, camera, pixels, Tile(0, 0, camera.width, camera.height), blockSize, previousBlockSize, cancel);
+
+		if (cancel != nullptr && *cancel)
+		{
+			cout << "Ray tracing cancelled" << endl;
+			return pixels;
+		}
+
+		auto t2 = std::chrono::high_resolution_clock::now();
+		stats.milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+
+		if (settings.printProgress)
+			cout << "Pass " << pass + 1 << " of " << numPasses << " done after " << stats.milliseconds << " milliseconds" << endl;
+
+		passDone(pixels, pass, numPasses);
+	}
+
+	return pixels;
+}
+
+void Renderer::renderPass(const vector<Tile>& tiles, const PinholeCamera& camera, ofPixels& pixels, const Tile& imageRegion, int blockSize, int previousBlockSize, const std::atomic<bool>* cancel,
+	RenderCheckpoint* checkpoint)
+{
+	std::atomic<int> tilesDone(0);
+
+	WorkStealingScheduler scheduler(settings.getNumThreads());
+
+	//each thread counts into its own stats, which are only added up once every thread is done
+	vector<RenderStats> threadStats(scheduler.getNumThreads());
+
+	scheduler.run(tiles.size(), [&](int tileIndex, int threadIndex)
+	{
+		//the scheduler has no way to stop early, so once the render is cancelled the remaining tiles are just skipped
+		if (cancel != nullptr && *cancel)
+			return;
+
+		//tiles loaded from the checkpoint still count towards the progress
+		if (checkpoint == nullptr || !checkpoint->isDone(tileIndex))
+		{
+			RenderStats::setCurrent(&threadStats[threadIndex]);
+			renderTile(tiles[tileIndex], camera, pixels, imageRegion, blockSize, previousBlockSize);
+			RenderStats::setCurrent(nullptr);
+
+			if (checkpoint != nullptr)
+				checkpoint->markDone(tileIndex);
+		}
+
+		int done = ++tilesDone;
+
+		//only one thread reports progress so the output doesn't get garbled
+		if (threadIndex == 0 && settings.printProgress)
+			cout << left << setw(5) << done * 100.f / tiles.size() << "% Complete\r" << flush;
+	});
+
+	if (settings.printProgress)
+		cout << left << setw(5) << 100 << "% Complete" << endl;
+
+	for (const RenderStats& threadStat : threadStats)
+		stats.merge(threadStat);
+}
+
+//sets every pixel of the block starting at (x, y) that is inside the tile. pixels holds the part of the image inside imageRegion
+static void fillBlock(ofPixels& pixels, const Tile& imageRegion, const Tile& tile, int x, int y, int blockSize, const ofColor& color)
+{
+	for (int blockY = y; blockY < min(y + blockSize, tile.y + tile.height); blockY++)
+	{
+		for (int blockX = x; blockX < min(x + blockSize, tile.x + tile.width); blockX++)
+			pixels.setColor(blockX - imageRegion.x, blockY - imageRegion.y, color);
+	}
+}
+
+void Renderer::renderTile(const Tile& tile, const PinholeCamera& camera, ofPixels& pixels, const Tile& imageRegion, int blockSize, int previousBlockSize)
+{
+	//pixels that were traced by the previous pass (if there was one) already have their final color
+	auto needsTracing = [&](int x, int y)
+	{
+		if (x >= tile.x + tile.width || y >= tile.y + tile.height)
+			return false;
+
+		return previousBlockSize == 0 || (x - tile.x) % previousBlockSize != 0 || (y - tile.y) % previousBlockSize != 0;
+	};
+
+	//each tile only writes to its own pixels, so the tiles can be traced in parallel without any locking
+	if (settings.isAntialiased())
+	{
+		for (int y = tile.y; y < tile.y + tile.height; y += blockSize)
+		{
+			for (int x = tile.x; x < tile.x + tile.width; x += blockSize)
+			{
+				if (needsTracing(x, y))
+					fillBlock(pixels, imageRegion, tile, x, y, blockSize, samplePixel(camera, x, y));
+			}
+		}
+
+		return;
+	}
+
+	if (!settings.usePacketTracing)
+	{
+		for (int y = tile.y; y < tile.y + tile.height; y += blockSize)
+		{
+			for (int x = tile.x; x < tile.x + tile.width; x += blockSize)
+			{
+				if (!needsTracing(x, y))
+					continue;
+
+				Ray ray = camera.getRay(x, y);
+
+				fillBlock(pixels, imageRegion, tile, x, y, blockSize, scene.intersectRayScene(ray));
+			}
+		}
+
+		return;
+	}
+
+	//neighboring pixels have nearly identical primary rays, so small blocks of them are traced as a packet.
+	//Lanes for pixels that are outside the tile or were traced by an earlier pass are left inactive
+	for (int y = tile.y; y < tile.y + tile.height; y += PACKET_HEIGHT * blockSize)
+	{
+		for (int x = tile.x; x < tile.x + tile.width; x += PACKET_WIDTH * blockSize)
+		{
+			RayPacket packet;
+
+			for (int lane = 0; lane < RayPacket::SIZE; lane++)
+			{
+				int pixelX = x + (lane % PACKET_WIDTH) * blockSize;
+				int pixelY = y + (lane / PACKET_WIDTH) * blockSize;
+
+				if (needsTracing(pixelX, pixelY))
+					packet.setRay(lane, camera.getRay(pixelX, pixelY));
+			}
+
+			if (packet.activeLanes == 0)
+				continue;
+
+			ofColor colors[RayPacket::SIZE];
+			scene.intersectPacket(packet, colors);
+
+			for (int lane = 0; lane < RayPacket::SIZE; lane++)
+			{
+				if (packet.isActive(lane))
+					fillBlock(pixels, imageRegion, tile, x + (lane % PACKET_WIDTH) * blockSize, y + (lane / PACKET_WIDTH) * blockSize, blockSize, colors[lane]);
+			}
+		}
+	}
+}
+
+//--------------------------------------------------------------
+
+//mixes the bits of a pixel's coordinates, so that every pixel gets its own (but always the same) scrambling of the sample pattern
+static uint32_t hashPixel(int x, int y, uint32_t seed)
+{
+	uint32_t h = (uint32_t)x * 0x8da6b343u ^ (uint32_t)y * 0xd8163841u ^ seed;
+
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	h *= 0x846ca68bu;
+	h ^= h >> 16;
+
+	return h;
+}
+
+/// <summary>
+/// The index'th point of the 2D Sobol sequence, with each coordinate's bits flipped by its scramble. Every run of the first 2^k points lands one point in
+/// each cell of a 2^k cell grid (in every way of cutting the square into 2^k equal rectangles), so the samples of a pixel are stratified however many are taken,
+/// and flipping bits moves cells around without breaking that
+/// </summary>
+static glm::vec2 sobolPoint(uint32_t index, uint32_t scrambleX, uint32_t scrambleY)
+{
+	uint32_t x = 0;
+	uint32_t y = 0;
+	uint32_t direction = 1u << 31;
+
+	for (int bit = 31; index != 0; index >>= 1, bit--, direction ^= direction >> 1)
+	{
+		if (index & 1)
+		{
+			x ^= 1u << bit;
+			y ^= direction;
+		}
+	}
+
+	//24 bits is all a float holds between 0 and 1, and keeping only those makes sure neither coordinate rounds up to 1
+	const float scale = 1.0f / (1 << 24);
+	return glm::vec2(((x ^ scrambleX) >> 8) * scale, ((y ^ scrambleY) >> 8) * scale);
+}
+
+ofColor Renderer::samplePixel(const PinholeCamera& camera, int x, int y)
+{
+	int maxSamples = settings.maxSamples;
+	int batchSize = max(1, min(settings.minSamples, maxSamples));
+
+	uint32_t scrambleX = hashPixel(x, y, 0x9e3779b9u);
+	uint32_t scrambleY = hashPixel(x, y, 0x85ebca6bu);
+
+	//the mean and variance of each channel are kept up to date as samples come in (Welford's method), which stays accurate however many samples there are
+	glm::vec3 mean(0);
+	glm::vec3 sumOfSquaredDifferences(0);
+	int numSamples = 0;
+
+	int firstObject = -1;
+	bool sameObject = true;
+
+	auto addSample = [&](const ofColor& color, int object)
+	{
+		if (numSamples == 0)
+			firstObject = object;
+		else if (object != firstObject)
+			sameObject = false;
+
+		numSamples++;
+
+		glm::vec3 value(color.r, color.g, color.b);
+		glm::vec3 difference = value - mean;
+		mean += difference / (float)numSamples;
+		sumOfSquaredDifferences += difference * (value - mean);
+	};
+
+	while (numSamples < maxSamples)
+	{
+		int batchEnd = min(numSamples + batchSize, maxSamples);
+
+		//the samples of one pixel are about as coherent as rays get, so they're traced as packets when packets are on
+		while (numSamples < batchEnd)
+		{
+			if (!settings.usePacketTracing)
+			{
+				glm::vec2 offset = sobolPoint(numSamples, scrambleX, scrambleY);
+				int object;
+				ofColor color = scene.intersectRayScene(camera.getRay(x + offset.x, y + offset.y), &object);
+
+				addSample(color, object);
+				continue;
+			}
+
+			RayPacket packet;
+			//SIZE is copied so that min doesn't take it by reference, which would need a definition of it to link without optimizations
+			int numLanes = min((int)RayPacket::SIZE, batchEnd - numSamples);
+
+			for (int lane = 0; lane < numLanes; lane++)
+			{
+				glm::vec2 offset = sobolPoint(numSamples + lane, scrambleX, scrambleY);
+				packet.setRay(lane, camera.getRay(x + offset.x, y + offset.y));
+			}
+
+			ofColor colors[RayPacket::SIZE];
+			int objects[RayPacket::SIZE];
+			scene.intersectPacket(packet, colors, objects);
+
+			for (int lane = 0; lane < numLanes; lane++)
+				addSample(colors[lane], objects[lane]);
+		}
+
+		//an edge between objects always gets more samples. Otherwise the pixel only does if its color is still uncertain, which takes at least two samples to tell
+		if (numSamples < 2 || !sameObject)
+			continue;
+
+		//the standard error of the mean is sqrt(variance / n), with the sample variance being sumOfSquaredDifferences / (n - 1)
+		glm::vec3 standardErrorSquared = sumOfSquaredDifferences / (float)(numSamples * (numSamples - 1));
+		float threshold = settings.aaThreshold;
+
+		if (max(standardErrorSquared.x, max(standardErrorSquared.y, standardErrorSquared.z)) <= threshold * threshold)
+			break;
+	}
+
+	return ofColor(std::round(mean.x), std::round(mean.y), std::round(mean.z));
+}
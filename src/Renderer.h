@@ -0,0 +1,147 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Scene.h"
+#include "GraphicalStructs.h"
+#include "RenderStats.h"
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <atomic>
+
+struct RenderSettings
+{
+	enum class TileOrder { ROW_MAJOR, MORTON };
+
+	int numThreads = 0; //0 means use every hardware thread
+	int tileSize = 32;
+	TileOrder tileOrder = TileOrder::MORTON;
+	bool usePacketTracing = true; //trace primary rays in SIMD packets of neighboring pixels
+	int previewBlockSize = 4; //the first progressive pass traces one pixel out of every previewBlockSize x previewBlockSize block. Rounded down to a power of two
+	bool printProgress = true; //print how far along each render is and how long it took
+
+	//adaptive anti-aliasing. Every pixel starts with minSamples stratified samples and gets minSamples more at a time, up to maxSamples, for as long as
+	//its samples hit different objects or the standard error of its color is above aaThreshold (on any channel, from 0 to 255).
+	//A maxSamples of 1 turns it off, which traces a single ray through the corner of every pixel
+	int minSamples = 4;
+	int maxSamples = 1;
+	float aaThreshold = 4;
+
+	//render() saves its finished tiles to checkpointPath (if it's set) every checkpointInterval seconds, and picks up from the tiles already there
+	//when it's started again with the same camera and settings (see RenderCheckpoint)
+	string checkpointPath;
+	float checkpointInterval = 60;
+
+	ReflectionLimits reflectionLimits;
+	IrradianceCacheSettings irradianceCache; //off by default. The scene keeps its cache between renders, so only the first render with it on pays for the lighting
+
+	int getNumThreads() const;
+	bool isAntialiased() const { return maxSamples > 1; }
+};
+
+class RenderCheckpoint;
+
+//a rectangular block of pixels that is traced by a single thread
+struct Tile
+{
+	Tile(int x, int y, int width, int height) : x(x), y(y), width(width), height(height) {}
+
+	int x;
+	int y;
+	int width;
+	int height;
+};
+
+/// <summary>
+/// Runs a list of jobs on a pool of threads. Each thread starts with its own contiguous run of jobs (so neighboring tiles stay on the same core)
+/// and, once its own queue is empty, steals from the back of another thread's queue
+/// </summary>
+class WorkStealingScheduler
+{
+public:
+	WorkStealingScheduler(int numThreads) : numThreads(max(1, numThreads)) {}
+
+	/// <summary>
+	/// Calls work(jobIndex, threadIndex) once for every job in [0, numJobs) and returns once all of them are done
+	/// </summary>
+	void run(int numJobs, const std::function<void(int, int)>& work);
+
+	int getNumThreads() const { return numThreads; }
+
+private:
+	struct JobQueue
+	{
+		std::mutex lock;
+		std::deque<int> jobs;
+	};
+
+	int numThreads;
+
+	bool popJob(vector<JobQueue>& queues, int threadIndex, int& job);
+};
+
+class Renderer
+{
+public:
+	Renderer(Scene& scene, RenderSettings settings = RenderSettings()) : scene(scene), settings(settings) {}
+
+	ofPixels render(const PinholeCamera& camera);
+
+	/// <summary>
+	/// Renders only the pixels of the camera's image inside region, returning an image the size of region. The pixels come out exactly the same as they do
+	/// in a full render as long as region starts on a multiple of the tile size, which is how the tile coordinator splits frames between workers
+	/// </summary>
+	ofPixels renderRegion(const PinholeCamera& camera, const Tile& region);
+
+	/// <summary>
+	/// Renders the image coarse to fine. The first pass traces one pixel out of every previewBlockSize x previewBlockSize block and fills the whole block with it;
+	/// each pass after that halves the block size and only traces the pixels that haven't been traced yet, so the final image is the same as the one render() makes.
+	/// passDone(pixels, pass, numPasses) is called on this thread after every pass. If cancel is set while rendering, the remaining tiles are skipped and the
+	/// partially rendered image is returned
+	/// </summary>
+	ofPixels renderProgressive(const PinholeCamera& camera, const std::function<void(const ofPixels&, int, int)>& passDone, const std::atomic<bool>* cancel = nullptr);
+
+	static vector<Tile> makeTiles(int width, int height, int tileSize, RenderSettings::TileOrder order);
+
+	RenderSettings& getSettings() { return settings; }
+
+	/// <summary>
+	/// The counters of every thread of the last render (or every pass of the last progressive render) added together
+	/// </summary>
+	const RenderStats& getStats() const { return stats; }
+
+private:
+	Scene& scene;
+	RenderSettings settings;
+	RenderStats stats;
+
+	//primary ray packets cover a block of pixels two rows tall
+	static const int PACKET_HEIGHT = 2;
+	static const int PACKET_WIDTH = RayPacket::SIZE / PACKET_HEIGHT;
+
+	/// <summary>
+	/// Clears the statistics for a new render of the given size
+	/// </summary>
+	void resetStats(int width, int height);
+
+	/// <summary>
+	/// Traces every tile on the thread pool into pixels, which holds the part of the image inside imageRegion. Only pixels on a grid spaced blockSize apart (measured from each tile's corner) are traced,
+	/// skipping the ones that were already on the grid of the previous pass (previousBlockSize, or 0 if there wasn't one). Each traced pixel fills the blockSize x blockSize block below and to the right of it.
+	/// If checkpoint is given, tiles it already has are skipped and every other tile is marked done in it once it's traced
+	/// </summary>
+	void renderPass(const vector<Tile>& tiles, const PinholeCamera& camera, ofPixels& pixels, const Tile& imageRegion, int blockSize, int previousBlockSize, const std::atomic<bool>* cancel,
+		RenderCheckpoint* checkpoint = nullptr);
+
+	void renderTile(const Tile& tile, const PinholeCamera& camera, ofPixels& pixels, const Tile& imageRegion, int blockSize, int previousBlockSize);
+
+	/// <summary>
+	/// A hash of everything that decides what render() makes of the scene with this camera, so that a checkpoint is only resumed by the render that saved it
+	/// </summary>
+	uint64_t getCheckpointKey(const PinholeCamera& camera) const;
+
+	/// <summary>
+	/// Traces samples inside pixel (x, y) until it has enough (see RenderSettings::maxSamples) and returns their average color
+	/// </summary>
+	ofColor samplePixel(const PinholeCamera& camera, int x, int y);
+};
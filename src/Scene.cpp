@@ -1,7 +1,9 @@
 #include "Scene.h"
+#include "RenderStats.h"
 #include "ofMain.h"
 #include "stdlib.h"
 #include <memory>
+#include <atomic>
 
 void Scene::draw()
 {
@@ -16,25 +18,141 @@ void Scene::draw()
 	}
 }
 
-ofColor Scene::intersectRayScene(const Ray& ray, bool reflection)
+void Scene::finalize()
 {
-	ofColor colorAtRay = DEFAULT_COLOR;
+	if (finalized)
+		return;
 
-	float closestDistance = std::numeric_limits<float>::infinity(); //represents the distance of the currently closest object
-	glm::vec3 closestPoint;
-	glm::vec3 closestNormal;
-	int closestObjectIndex = -1;
+	vector<int> opaque;
+	transparentSurfaces.clear();
 
 	for (int i = 0; i < surfaces.size(); i++)
 	{
-		glm::vec3 intersectPoint;
-		glm::vec3 intersectNormal;
-		bool bIntersect = surfaces[i]->intersects(ray, intersectPoint, intersectNormal);
+		if (surfaces[i]->isTransparent())
+			transparentSurfaces.push_back(i);
+		else
+			opaque.push_back(i);
+	}
+
+	opaqueSurfaces.build(surfaces, opaque);
+	finishFinalize();
+}
+
+void Scene::refit()
+{
+	if (!finalized)
+	{
+		finalize();
+		return;
+	}
+
+	//transparent surfaces aren't in the BVH, so they need nothing more than their own new transforms
+	opaqueSurfaces.refit();
+	resetIrradianceCache();
+}
+
+void Scene::setIrradianceCacheSettings(const IrradianceCacheSettings& settings)
+{
+	if (settings == irradianceSettings)
+		return;
+
+	irradianceSettings = settings;
+	resetIrradianceCache();
+}
+
+void Scene::resetIrradianceCache()
+{
+	irradianceCache = irradianceSettings.enabled ? make_shared<IrradianceCache>(irradianceSettings.spacing, irradianceSettings.maxError) : nullptr;
+}
+
+void Scene::finishFinalize()
+{
+	static std::atomic<uint64_t> lastFinalizeId(0);
+
+	lightTree.build(lights);
+	finalizeId = ++lastFinalizeId;
+
+	//the lighting may have changed along with the scene
+	resetIrradianceCache();
+	finalized = true;
+}
+
+ofColor Scene::intersectRayScene(const Ray& ray, int* hitObject)
+{
+	//reflection rays are counted by calculateShading, which also keeps track of how deep they go
+	if (RenderStats* stats = RenderStats::current())
+		stats->primaryRays++;
+
+	return traceRay(ray, { 0, 1 }, hitObject);
+}
+
+ofColor Scene::traceRay(const Ray& ray, const PathState& path, int* hitObject)
+{
+	//only the closest opaque object matters, which is what the BVH finds
+	HitRecord closestHit;
+	opaqueSurfaces.intersect(ray, closestHit);
+
+	if (hitObject)
+		*hitObject = closestHit.objectIndex;
+
+	return shadeRay(ray, closestHit, path);
+}
+
+void Scene::intersectPacket(const RayPacket& packet, ofColor* colors, int* hitObjects)
+{
+	if (RenderStats* stats = RenderStats::current())
+		stats->primaryRays += simd::countLanes(packet.activeLanes);
+
+	int closestObjects[RayPacket::SIZE];
+	opaqueSurfaces.intersectPacket(packet, closestObjects);
+
+	for (int lane = 0; lane < RayPacket::SIZE; lane++)
+	{
+		if (!packet.isActive(lane))
+			continue;
+
+		Ray ray = packet.getRay(lane);
+		HitRecord closestHit;
+		int closestObjectIndex = closestObjects[lane];
+
+		//the packet only tells us which object is closest, so the rest of the hit comes from the object itself (which also takes care of things like normal maps).
+		//If the two disagree about a ray that just grazes the object's edge, fall back to tracing the ray on its own
+		if (closestObjectIndex != -1)
+		{
+			if (surfaces[closestObjectIndex]->intersects(ray, closestHit))
+				closestHit.objectIndex = closestObjectIndex;
+			else
+			{
+				closestHit = HitRecord();
+				opaqueSurfaces.intersect(ray, closestHit);
+			}
+		}
+
+		if (hitObjects)
+			hitObjects[lane] = closestHit.objectIndex;
+
+		colors[lane] = shadeRay(ray, closestHit, { 0, 1 });
+	}
+}
+
+ofColor Scene::shadeRay(const Ray& ray, const HitRecord& closestHit, const PathState& path)
+{
+	ofColor colorAtRay = DEFAULT_COLOR;
+	RenderStats* stats = RenderStats::current();
+
+	for (int i : transparentSurfaces)
+	{
+		HitRecord hit;
+		bool bIntersect = surfaces[i]->intersects(ray, hit);
+
+		if (stats)
+			stats->countTest(surfaces[i]->getPrimitiveType(), bIntersect);
 
 		//if the object is transparent, add the color (and do a bunch of opacity math) to the colorAtRay
-		if (bIntersect && surfaces[i]->isTransparent())
+		if (bIntersect)
 		{
-			ofColor transparentColor = calculateShading(ray, *surfaces[i], intersectPoint, intersectNormal);
+			hit.objectIndex = i;
+			ofColor transparentColor = calculateShading(ray, *surfaces[i], hit, path);
 			//this is built on the assumption that, if we're intersecting a transparent object and the colorAtRay is 255, then we haven't intersected any object before so we can just set the opacity to the current color
 			if (colorAtRay.a == 255)
 			{
@@ -54,84 +172,214 @@ ofColor Scene::intersectRayScene(const Ray& ray, bool reflection)
 			//OF uses the alpha value of the left term (which we've already taken care of)
 			colorAtRay += transparentColor;
 		}
-		//otherwise, ray trace as usual
-		else if (bIntersect)
-		{
-			float currentDistance = glm::distance2(intersectPoint, ray.origin);
-
-			if (currentDistance < closestDistance) //if we find an intersection, test to see if it is the closest one
-			{
-				closestDistance = currentDistance;
-				closestPoint = intersectPoint;
-				closestNormal = intersectNormal;
-				closestObjectIndex = i;
-			}
-		}
 	}
 
-	if (closestObjectIndex != -1)
+	if (closestHit.objectIndex != -1)
 	{
 		//this helps prevent any transparent objects from combining their color too much with we are ray tracing
 		float transparencyMultiplier = colorAtRay.a / 255.0;
 
-		colorAtRay = transparencyMultiplier * colorAtRay + calculateShading(ray, *surfaces[closestObjectIndex], closestPoint, closestNormal);
+		colorAtRay = transparencyMultiplier * colorAtRay + calculateShading(ray, *surfaces[closestHit.objectIndex], closestHit, path);
 	}
 
 	return colorAtRay;
 }
 
-ofColor Scene::calculateShading(const Ray& ray, SceneObject& object, glm::vec3& intersectPoint, glm::vec3& intersectNormal)
+//--------------------------------------------------------------
+
+/// <summary>
+/// The last opaque object that blocked a shadow ray to each light, kept separately by every thread so that nothing is shared between them.
+/// Neighboring pixels are usually shadowed by the same object, so testing it first often finds the answer without searching the BVH at all.
+/// The cache belongs to whichever scene used it last, and starts over when another scene (or the same one finalized again) uses it
+/// </summary>
+struct ShadowOccluderCache
 {
-	ofColor finalColor = object.getDiffuseColor(intersectPoint) * AMBIENT_SHADING_INTENSITY;
+	uint64_t finalizeId = 0;
+	vector<int> occluders; //one object index per light, -1 if no shadow ray to the light has been blocked yet
+};
 
-	//for the time being, if an object is transparent, don't provide any ambient light for it. I think it looks better this way
-	if (object.isTransparent())
-		finalColor = ofColor::black;
+static thread_local ShadowOccluderCache shadowOccluderCache;
 
-	glm::vec3 shadowRayOrigin = intersectPoint + SHADOW_NORMAL_MULTIPLIER * intersectNormal;
-	
-	for (auto light : lights)
+float Scene::transmittanceToLight(const Ray& rayToLight, int lightIndex)
+{
+	RenderStats* stats = RenderStats::current();
+	if (stats)
+		stats->shadowRays++;
+
+	ShadowOccluderCache& cache = shadowOccluderCache;
+	if (cache.finalizeId != finalizeId)
 	{
-		Ray rayToLight = light->getRayToLight(shadowRayOrigin);
-		
-		bool lightBlocked = false;
-		float percentLightReachedObject = 1.0;
+		cache.finalizeId = finalizeId;
+		cache.occluders.assign(lights.size(), -1);
+	}
 
-		for (shared_ptr<SceneObject> blockingObject : surfaces)
+	int& lastOccluder = cache.occluders[lightIndex];
+
+	if (lastOccluder != -1)
+	{
+		bool occluded = surfaces[lastOccluder]->occludes(rayToLight);
+
+		if (stats)
 		{
-			glm::vec3 junk1, junk2;
-			lightBlocked = blockingObject->intersects(rayToLight, junk1, junk2);
-				
-			//if there is a transparent object blocking another object, then reduce the amount of light that reaches the object, but don't block out the object entirely
-			if (lightBlocked && blockingObject->isTransparent())
-			{
-				lightBlocked = false;
-				//blockingObject.color.alpha / 255 gives us the %light that gets blocked, so subtracting it from 1 gives us the %light that makes it through
-				percentLightReachedObject *= 1.0 - blockingObject->getDiffuseColor().a / 255.0;
-			}
-			else if (lightBlocked)
-				break;
-				
+			stats->countTest(surfaces[lastOccluder]->getPrimitiveType(), occluded);
+			stats->shadowCacheHits += occluded;
 		}
-		
-		if (!lightBlocked)
-		{
-			glm::vec3 lightVec = percentLightReachedObject * light->lightAt(intersectPoint);
 
-			ofColor lambertShading = object.getDiffuseColor(intersectPoint) * max(0.f, glm::dot(lightVec, intersectNormal));
+		if (occluded)
+			return 0;
+	}
+
+	//the last occluder is kept even when a ray gets through, since the next pixel over is often back in its shadow
+	int occluder;
+	if (opaqueSurfaces.occludes(rayToLight, &occluder))
+	{
+		lastOccluder = occluder;
+		return 0;
+	}
 
-			//ray.direction points from viewer to the point, but h bisects the light vector and a viewing vector that points from the point to the viewer, hence why we subtract ray.direction
-			glm::vec3 h = (lightVec - ray.direction) / glm::length(lightVec - ray.direction);
+	float transmittance = 1.0;
 
-			ofColor phongShading = object.getSpectralColor(intersectPoint) * glm::length(lightVec) * pow(max(0.f, glm::dot(h, intersectNormal)), SPECTRAL_POWER);
+	//if there is a transparent object blocking another object, then reduce the amount of light that reaches the object, but don't block out the object entirely
+	for (int i : transparentSurfaces)
+	{
+		bool occluded = surfaces[i]->occludes(rayToLight);
 
-			finalColor += lambertShading + phongShading;
+		if (stats)
+			stats->countTest(surfaces[i]->getPrimitiveType(), occluded);
 
-			//OF doesn't seem to handle opacity very well, so I have to manually set the opacity 
-			finalColor.a = lambertShading.a;
+		if (occluded)
+		{
+			//alpha / 255 gives us the %light that gets blocked, so subtracting it from 1 gives us the %light that makes it through
+			transmittance *= 1.0 - surfaces[i]->getDiffuseColor().a / 255.0;
+
+			if (transmittance < MIN_TRANSMITTANCE)
+				return 0;
 		}
 	}
 
+	return transmittance;
+}
+
+float Scene::specularIntensity(const Ray& ray, const glm::vec3& lightVec, const glm::vec3& normal) const
+{
+	//ray.direction points from viewer to the point, but h bisects the light vector and a viewing vector that points from the point to the viewer, hence why we subtract ray.direction
+	glm::vec3 h = (lightVec - ray.direction) / glm::length(lightVec - ray.direction);
+
+	return glm::length(lightVec) * pow(max(0.f, glm::dot(h, normal)), SPECTRAL_POWER);
+}
+
+glm::vec3 Scene::gatherIrradiance(const HitRecord& hit, const glm::vec3& shadowRayOrigin)
+{
+	glm::vec3 irradiance(0);
+
+	lightTree.forEachLightAt(hit.point, [&](int lightIndex)
+	{
+		Light& light = *lights[lightIndex];
+		glm::vec3 lightVec = light.lightAt(hit.point);
+
+		//lights behind the surface add nothing to its diffuse shading, and would cancel out the ones in front if they were summed in
+		if (!light.canLight(hit.point) || glm::dot(lightVec, hit.normal) <= 0)
+			return;
+
+		irradiance += transmittanceToLight(light.getRayToLight(shadowRayOrigin), lightIndex) * lightVec;
+	});
+
+	return irradiance;
+}
+
+ofColor Scene::shadeFromIrradianceCache(const Ray& ray, const HitRecord& hit, const ofColor& diffuseColor, const ofColor& spectralColor, const glm::vec3& shadowRayOrigin)
+{
+	RenderStats* stats = RenderStats::current();
+	glm::vec3 irradiance;
+	int numNearby;
+
+	if (irradianceCache->find(hit, irradiance, numNearby))
+	{
+		if (stats)
+			stats->irradianceCacheHits++;
+	}
+	else
+	{
+		irradiance = gatherIrradiance(hit, shadowRayOrigin);
+		irradianceCache->add(hit, irradiance, numNearby);
+	}
+
+	ofColor lighting = diffuseColor * max(0.f, glm::dot(irradiance, hit.normal));
+
+	//highlights are too sharp to interpolate, so each light's is worked out here. Most of them are too faint to show up even without a shadow, so only the
+	//ones that could add at least a whole step to a color channel get a shadow ray
+	float maxSpectral = max(spectralColor.r, max(spectralColor.g, spectralColor.b));
+
+	lightTree.forEachLightAt(hit.point, [&](int lightIndex)
+	{
+		Light& light = *lights[lightIndex];
+
+		if (!light.canLight(hit.point))
+			return;
+
+		glm::vec3 lightVec = light.lightAt(hit.point);
+
+		if (maxSpectral * specularIntensity(ray, lightVec, hit.normal) < 1)
+			return;
+
+		float transmittance = transmittanceToLight(light.getRayToLight(shadowRayOrigin), lightIndex);
+
+		if (transmittance > 0)
+			lighting += spectralColor * specularIntensity(ray, transmittance * lightVec, hit.normal);
+	});
+
+	return lighting;
+}
+
+ofColor Scene::calculateShading(const Ray& ray, SceneObject& object, const HitRecord& hit, const PathState& path)
+{
+	const glm::vec3& intersectPoint = hit.point;
+	const glm::vec3& intersectNormal = hit.normal;
+
+	//textured objects sample their textures here, once for the whole hit rather than once per light
+	ofColor diffuseColor = object.getDiffuseColor(hit);
+	ofColor spectralColor = object.getSpectralColor(hit);
+
+	ofColor finalColor = diffuseColor * AMBIENT_SHADING_INTENSITY;
+
+	//for the time being, if an object is transparent, don't provide any ambient light for it. I think it looks better this way.
+	//Its opacity comes from its own color, whether or not any light reaches it
+	if (object.isTransparent())
+		finalColor = ofColor(0, 0, 0, diffuseColor.a);
+
+	glm::vec3 shadowRayOrigin = intersectPoint + SHADOW_NORMAL_MULTIPLIER * intersectNormal;
+	
+	//transparent objects are always lit from scratch, since they aren't diffuse enough for the cache to be worth it
+	if (irradianceCache && !object.isTransparent())
+	{
+		finalColor += shadeFromIrradianceCache(ray, hit, diffuseColor, spectralColor, shadowRayOrigin);
+	}
+	else
+	{
+		//only the lights whose reach includes the point are looked at, and only the ones that can actually light it (in range and, for spotlights, in their cone) get a shadow ray
+		lightTree.forEachLightAt(intersectPoint, [&](int lightIndex)
+		{
+			Light& light = *lights[lightIndex];
+
+			if (!light.canLight(intersectPoint))
+				return;
+
+			Ray rayToLight = light.getRayToLight(shadowRayOrigin);
+		
+			float percentLightReachedObject = transmittanceToLight(rayToLight, lightIndex);
+		
+			if (percentLightReachedObject > 0)
+			{
+				glm::vec3 lightVec = percentLightReachedObject * light.lightAt(intersectPoint);
+
+				ofColor lambertShading = diffuseColor * max(0.f, glm::dot(lightVec, intersectNormal));
+				ofColor phongShading = spectralColor * specularIntensity(ray, lightVec, intersectNormal);
+
+				finalColor += lambertShading + phongShading;
+			}
+		});
+	}
+
 	//if the object is reflective, then basically repeat the process all over again
 	if (object.isReflective())
 	{
@@ -141,10 +389,75 @@ ofColor Scene::calculateShading(const Ray& ray, SceneObject& object, glm::vec3&
 		//the point is offset by a little bit just so that we don't end up reflecting with ourself
 		Ray reflectionRay(intersectPoint + reflectionDirection * SHADOW_NORMAL_MULTIPLIER, reflectionDirection);
 
-		ofColor reflection = intersectRayScene(reflectionRay, true);
+		PathState reflectionPath = { path.depth + 1, path.weight * object.getReflectance() };
+		float survivalScale;
+
+		RenderStats* stats = RenderStats::current();
+
+		if (continuePath(reflectionRay, reflectionPath, survivalScale))
+		{
+			if (stats)
+				stats->enterReflection();
+
+			ofColor reflection = traceRay(reflectionRay, reflectionPath, nullptr);
+
+			if (stats)
+				stats->leaveReflection();
 
-		finalColor += object.getReflectance() * reflection;
+			finalColor += object.getReflectance() * survivalScale * reflection;
+		}
+		else if (stats)
+		{
+			stats->skippedReflections++;
+		}
 	}
 
 	return finalColor;
+}
+
+//a number in [0, 1) that only depends on the ray, so that Russian roulette makes the same choices no matter which thread traces the ray
+static float hashRay(const Ray& ray)
+{
+	uint32_t hash = 2166136261u;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		uint32_t originBits, directionBits;
+		memcpy(&originBits, &ray.origin[axis], sizeof(uint32_t));
+		memcpy(&directionBits, &ray.direction[axis], sizeof(uint32_t));
+
+		hash = (hash ^ originBits) * 16777619u;
+		hash = (hash ^ directionBits) * 16777619u;
+	}
+
+	//mixes the bits so that the top ones (which are the ones used) depend on every input bit
+	hash ^= hash >> 16;
+	hash *= 0x7feb352du;
+	hash ^= hash >> 15;
+	hash *= 0x846ca68bu;
+	hash ^= hash >> 16;
+
+	return (hash >> 8) * (1.0f / (1 << 24));
+}
+
+bool Scene::continuePath(const Ray& reflectionRay, PathState& reflectionPath, float& survivalScale) const
+{
+	survivalScale = 1;
+
+	if (reflectionPath.depth > reflectionLimits.maxDepth)
+		return false;
+
+	if (!reflectionLimits.russianRoulette)
+		return reflectionPath.weight >= reflectionLimits.minWeight;
+
+	if (reflectionPath.weight >= reflectionLimits.rouletteWeight)
+		return true;
+
+	float survivalChance = reflectionPath.weight / reflectionLimits.rouletteWeight;
+	if (!(hashRay(reflectionRay) < survivalChance))
+		return false;
+
+	survivalScale = 1 / survivalChance;
+	reflectionPath.weight = reflectionLimits.rouletteWeight;
+	return true;
 }
\ No newline at end of file
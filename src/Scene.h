@@ -2,6 +2,24 @@
 
 #include "GraphicalStructs.h"
 #include "SceneObjects.h"
+#include "BVH.h"
+#include "LightTree.h"
+#include "IrradianceCache.h"
+
+/// <summary>
+/// How far chains of reflections are followed. A reflection's weight is how much its color can still add to the pixel it started from:
+/// 1 for primary rays, multiplied by the reflectance of every surface along the way
+/// </summary>
+struct ReflectionLimits
+{
+	int maxDepth = 8; //the most reflections in a row any ray gets, which puts an upper bound on the work per pixel
+	float minWeight = 1 / 256.0; //reflections that would add less than this are skipped (a weight this low can't change the pixel by a whole step)
+
+	//with Russian roulette, reflections with a weight below rouletteWeight are traced at random instead, with a chance of weight / rouletteWeight.
+	//The ones that are traced count for the ones that weren't, so the image comes out the same on average, and minWeight isn't used
+	bool russianRoulette = false;
+	float rouletteWeight = .1;
+};
 
 class Scene
 {
@@ -11,6 +29,7 @@ public:
 	{
 		auto light_ptr = make_shared<T>(light);
 		lights.push_back(light_ptr);
+		finalized = false;
 	}
 
 	template<typename T>
@@ -18,19 +37,127 @@ public:
 	{
 		auto obj_ptr = make_shared<T>(sceneObject);
 		surfaces.push_back(obj_ptr);
+		finalized = false;
 	}
 
+	/// <summary>
+	/// Builds the acceleration structures over the scene's surfaces and lights. This has to be called after the last object or light is added and before any rays are traced
+	/// </summary>
+	void finalize();
+	bool isFinalized() { return finalized; }
+
+	/// <summary>
+	/// Brings a finalized scene up to date after some of its instances were moved (see Instance::setTransform) by refitting the BVH instead of building it again.
+	/// Objects can't be added or removed this way, and the irradiance cache is cleared since the lighting may have changed
+	/// </summary>
+	void refit();
+
+	//the objects in the order they were added, which is the order that object indices (like HitRecord::objectIndex) count in
+	int getNumObjects() const { return surfaces.size(); }
+	int getNumLights() const { return lights.size(); }
+	const shared_ptr<SceneObject>& getObject(int index) const { return surfaces[index]; }
+	const shared_ptr<Light>& getLight(int index) const { return lights[index]; }
+
 	void draw();
-	ofColor intersectRayScene(const Ray& ray, bool reflection = false);
+
+	/// <summary>
+	/// Traces a primary ray and returns its color. If hitObject is given, it gets the index of the closest opaque object the ray hit (-1 if it didn't hit one)
+	/// </summary>
+	ofColor intersectRayScene(const Ray& ray, int* hitObject = nullptr);
+
+	/// <summary>
+	/// Traces every active lane of a packet of primary rays, writing one color per lane (and, if hitObjects is given, one object index per lane like intersectRayScene).
+	/// The closest opaque hits are found for the whole packet at once; everything after that (transparency, shading, shadows and reflections) is done one ray at a time,
+	/// exactly like intersectRayScene
+	/// </summary>
+	void intersectPacket(const RayPacket& packet, ofColor* colors, int* hitObjects = nullptr);
+
+	//the limits can't be changed while rays are being traced
+	void setReflectionLimits(const ReflectionLimits& limits) { reflectionLimits = limits; }
+	const ReflectionLimits& getReflectionLimits() const { return reflectionLimits; }
+
+	/// <summary>
+	/// Turns the irradiance cache on or off. Its samples are kept between renders until the scene is finalized again or these settings change,
+	/// so renders that only move the camera reuse the lighting worked out by the ones before. Like the reflection limits, this can't be changed while rays are being traced
+	/// </summary>
+	void setIrradianceCacheSettings(const IrradianceCacheSettings& settings);
+	const IrradianceCacheSettings& getIrradianceCacheSettings() const { return irradianceSettings; }
+
+	friend class SceneSnapshot; //reads and writes baked scene files
 
 private:
 	const ofColor DEFAULT_COLOR = ofColor::black;
 	const float AMBIENT_SHADING_INTENSITY = .18;
 	const float SPECTRAL_POWER = 1000;
 	const float SHADOW_NORMAL_MULTIPLIER = .01;
+	const float MIN_TRANSMITTANCE = .01; //once less than this much light makes it through transparent objects, treat the light as blocked
 
 	vector<shared_ptr<Light>> lights;
 	vector<shared_ptr<SceneObject>> surfaces;
 
-	ofColor calculateShading(const Ray& ray, SceneObject& object, glm::vec3& intersectPoint, glm::vec3& intersectNormal);
+	//every transparent surface that a ray passes through adds to its color (not just the closest one), so they are tested separately instead of being put in the BVH
+	vector<int> transparentSurfaces;
+	BVH opaqueSurfaces;
+	LightTree lightTree;
+	bool finalized = false;
+	uint64_t finalizeId = 0; //different every time any scene is finalized, so that per-thread caches can tell whether they belong to this scene as it is now
+
+	ReflectionLimits reflectionLimits;
+
+	IrradianceCacheSettings irradianceSettings;
+	shared_ptr<IrradianceCache> irradianceCache; //nullptr when it's turned off
+
+	void resetIrradianceCache();
+
+	/// <summary>
+	/// Builds the light tree and marks the scene as finalized, once its surfaces are ready to trace (either built by finalize or loaded from a snapshot)
+	/// </summary>
+	void finishFinalize();
+
+	//where a ray is in a chain of reflections: how many reflections deep it is, and its weight (see ReflectionLimits)
+	struct PathState
+	{
+		int depth;
+		float weight;
+	};
+
+	/// <summary>
+	/// Traces a primary or reflection ray. hitObject is the same as in intersectRayScene
+	/// </summary>
+	ofColor traceRay(const Ray& ray, const PathState& path, int* hitObject);
+
+	/// <summary>
+	/// Decides whether the reflection ray, which would bring its path to reflectionPath, gets traced. If Russian roulette picks it to stand in for the reflections
+	/// like it that aren't traced, its weight is raised to match and survivalScale is set to how much more its color counts (it is 1 otherwise)
+	/// </summary>
+	bool continuePath(const Ray& reflectionRay, PathState& reflectionPath, float& survivalScale) const;
+
+	/// <summary>
+	/// Returns the fraction of light that makes it along a shadow ray to lights[lightIndex], which is 0 if there is an opaque object in the way.
+	/// The object that blocked the last shadow ray to the same light on this thread is tested before the BVH is searched
+	/// </summary>
+	float transmittanceToLight(const Ray& rayToLight, int lightIndex);
+
+	/// <summary>
+	/// Combines the transparent surfaces along the ray with the shading of the closest opaque hit (whose objectIndex is -1 if nothing opaque was hit)
+	/// </summary>
+	ofColor shadeRay(const Ray& ray, const HitRecord& closestHit, const PathState& path);
+
+	ofColor calculateShading(const Ray& ray, SceneObject& object, const HitRecord& hit, const PathState& path);
+
+	/// <summary>
+	/// How bright the specular highlight of a light is at the point, where lightVec is the light (already dimmed by anything in its way) reaching it
+	/// </summary>
+	float specularIntensity(const Ray& ray, const glm::vec3& lightVec, const glm::vec3& normal) const;
+
+	/// <summary>
+	/// The irradiance vector at the hit: the sum of every light vector reaching it from in front of the surface, each dimmed by whatever is in its way (see IrradianceCache)
+	/// </summary>
+	glm::vec3 gatherIrradiance(const HitRecord& hit, const glm::vec3& shadowRayOrigin);
+
+	/// <summary>
+	/// The direct lighting of an opaque hit with the irradiance cache on: diffuse shading interpolated from the cache (or gathered and added to it),
+	/// and specular highlights worked out for every light that could make one
+	/// </summary>
+	ofColor shadeFromIrradianceCache(const Ray& ray, const HitRecord& hit, const ofColor& diffuseColor, const ofColor& spectralColor, const glm::vec3& shadowRayOrigin);
 };
\ No newline at end of file
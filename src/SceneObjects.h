@@ -1,6 +1,9 @@
 #pragma once
 
 #include "GraphicalStructs.h"
+#include "Primitives.h"
+#include "Texture.h"
+#include "RenderStats.h"
 
 
 class SceneObject
@@ -12,19 +15,57 @@ public:
 		: diffuseColor(diffuseColor), spectralColor(spectralColor) {}
 
 	virtual void draw() = 0;
-	virtual bool intersects(const Ray& ray, glm::vec3& intersectPoint, glm::vec3& intersectNormal) = 0;
+	//fills in everything in hit except objectIndex, which the object doesn't know
+	virtual bool intersects(const Ray& ray, HitRecord& hit) = 0;
 
+	//used by shadow rays, which only need to know if anything is hit before ray.maxDistance, not where or what the normal is there
+	virtual bool occludes(const Ray& ray) { HitRecord junk; return intersects(ray, junk); }
+
+	//tests the lanes of the packet in laneMask all at once, used for coherent primary rays. Writes the distance along the ray of every lane that hits into distances
+	//(which must be aligned like RayPacket's arrays) and returns a mask of those lanes. Only the distance is found; the rest of the hit comes from intersects().
+	//By default this just calls intersects() on one lane at a time
+	virtual int intersectPacket(const RayPacket& packet, int laneMask, float* distances)
+	{
+		int hitLanes = 0;
+
+		for (int lane = 0; lane < RayPacket::SIZE; lane++)
+		{
+			HitRecord hit;
+
+			if (((laneMask >> lane) & 1) && intersects(packet.getRay(lane), hit))
+			{
+				distances[lane] = hit.distance;
+				hitLanes |= 1 << lane;
+			}
+		}
+
+		return hitLanes;
+	}
+
+	//objects that are a plain sphere or axis aligned quad describe themselves here, so that the BVH can keep a copy of the shape and intersect it directly.
+	//Everything else is intersected through the virtual functions above
+	virtual PrimitiveShape getShape() { return PrimitiveShape(); }
+
+	//the bounds of everything that intersects() can hit, used to build the scene's BVH
+	virtual AABB getBounds() = 0;
+
+	//which counter the object's intersection tests go under in RenderStats
+	virtual RenderStats::PrimitiveType getPrimitiveType() = 0;
+
+	//the colors at a hit on this object, which textured objects look up with the hit's uv (and face)
 	virtual ofColor getDiffuseColor() { return diffuseColor; }
-	virtual ofColor getDiffuseColor(const glm::vec3& point) { return diffuseColor; }
+	virtual ofColor getDiffuseColor(const HitRecord&) { return diffuseColor; }
 
 	virtual ofColor getSpectralColor() { return spectralColor; }
-	virtual ofColor getSpectralColor(const glm::vec3& point) { return spectralColor; }
+	virtual ofColor getSpectralColor(const HitRecord&) { return spectralColor; }
 
 	virtual bool isReflective() { return false; }
 	virtual float getReflectance() { return 0.0; }
 
 	virtual bool isTransparent() { return false; }
 
+	friend class SceneSnapshot; //reads and writes baked scene files
+
 private:
 	ofColor diffuseColor;
 	ofColor spectralColor;
@@ -0,0 +1,780 @@
+#include "SceneSnapshot.h"
+#include "MappedFile.h"
+#include "SphereObjects.h"
+#include "PlaneObjects.h"
+#include "BoxObjects.h"
+#include "InstanceObjects.h"
+
+//--------------------------------------------------------------
+
+namespace
+{
+	const char MAGIC[8] = { 'M', 'O', 'O', 'N', 'B', 'A', 'K', 'E' };
+	const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+	//large arrays are aligned so that they can be used straight out of the mapped file
+	const uint64_t ARRAY_ALIGNMENT = 16;
+
+	struct SnapshotHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t byteOrderMark;
+		uint32_t headerSize; //these sizes catch files written by a build with a different struct layout
+		uint32_t bvhNodeSize;
+
+		uint64_t texturesOffset;
+		uint64_t heightfieldsOffset;
+		uint64_t objectsOffset;
+		uint64_t lightsOffset;
+		uint64_t accelerationOffset;
+		uint64_t fileSize;
+	};
+}
+
+//--------------------------------------------------------------
+
+class SceneSnapshot::Writer
+{
+public:
+	Writer(const string& path) : out(path, ios::binary | ios::trunc), position(0) {}
+
+	bool isGood() const { return (bool)out; }
+	uint64_t getPosition() const { return position; }
+
+	template<typename T>
+	void write(const T& value) { writeBytes(&value, sizeof(T)); }
+
+	void writeBytes(const void* bytes, size_t numBytes)
+	{
+		out.write(static_cast<const char*>(bytes), numBytes);
+		position += numBytes;
+	}
+
+	void align()
+	{
+		static const char zeros[ARRAY_ALIGNMENT] = { 0 };
+		uint64_t padding = (ARRAY_ALIGNMENT - position % ARRAY_ALIGNMENT) % ARRAY_ALIGNMENT;
+		writeBytes(zeros, padding);
+	}
+
+	//arrays are stored as their length followed by their (aligned) contents
+	template<typename T>
+	void writeArray(const T* values, uint64_t count)
+	{
+		write(count);
+		align();
+		writeBytes(values, count * sizeof(T));
+	}
+
+	void writeHeaderAt(const SnapshotHeader& header)
+	{
+		out.seekp(0);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	}
+
+private:
+	ofstream out;
+	uint64_t position;
+};
+
+class SceneSnapshot::Reader
+{
+public:
+	Reader(unsigned char* data, uint64_t size) : data(data), size(size), position(0), failed(false) {}
+
+	bool hasFailed() const { return failed; }
+
+	//for values that were read fine but don't make sense
+	void fail() { failed = true; }
+
+	void seek(uint64_t offset)
+	{
+		if (offset > size)
+			failed = true;
+		else
+			position = offset;
+	}
+
+	template<typename T>
+	T read()
+	{
+		T value{};
+
+		const unsigned char* bytes = readBytes(sizeof(T));
+		if (bytes != nullptr)
+			memcpy(&value, bytes, sizeof(T));
+
+		return value;
+	}
+
+	//bools are read as a byte and checked, since a bool holding anything but 0 or 1 is undefined behaviour
+	bool readBool()
+	{
+		uint8_t value = read<uint8_t>();
+
+		if (value > 1)
+			failed = true;
+
+		return value == 1;
+	}
+
+	//returns a pointer into the file (not a copy), or nullptr if the file is too short
+	unsigned char* readBytes(uint64_t numBytes)
+	{
+		if (failed || numBytes > size - position)
+		{
+			failed = true;
+			return nullptr;
+		}
+
+		unsigned char* bytes = data + position;
+		position += numBytes;
+		return bytes;
+	}
+
+	void align()
+	{
+		seek(position + (ARRAY_ALIGNMENT - position % ARRAY_ALIGNMENT) % ARRAY_ALIGNMENT);
+	}
+
+	template<typename T>
+	T* readArray(uint64_t& count)
+	{
+		count = read<uint64_t>();
+		align();
+
+		//checked against the size first so a corrupt count can't overflow the multiplication
+		if (failed || count > size / sizeof(T))
+		{
+			failed = true;
+			count = 0;
+			return nullptr;
+		}
+
+		return reinterpret_cast<T*>(readBytes(count * sizeof(T)));
+	}
+
+	template<typename T>
+	void readVector(vector<T>& values)
+	{
+		uint64_t count;
+		T* array = readArray<T>(count);
+		values.clear();
+
+		if (array != nullptr)
+			values.assign(array, array + count);
+	}
+
+private:
+	unsigned char* data;
+	uint64_t size;
+	uint64_t position;
+	bool failed;
+};
+
+//--------------------------------------------------------------
+
+//textures and heightfields are numbered in the order they're first used, so that each one is written once however many objects share it
+template<typename T>
+static int32_t getSharedIndex(const shared_ptr<T>& shared, map<T*, int>& indices)
+{
+	if (shared == nullptr)
+		return -1;
+
+	auto existing = indices.find(shared.get());
+	if (existing != indices.end())
+		return existing->second;
+
+	int index = indices.size();
+	indices[shared.get()] = index;
+	return index;
+}
+
+shared_ptr<Texture> SceneSnapshot::readTexture(Reader& in, const vector<shared_ptr<Texture>>& textures)
+{
+	int32_t index = in.read<int32_t>();
+
+	if (index < -1 || index >= (int32_t)textures.size())
+		in.fail();
+
+	if (index < 0 || index >= (int32_t)textures.size())
+		return nullptr;
+
+	return textures[index];
+}
+
+shared_ptr<const Heightfield> SceneSnapshot::readHeightfield(Reader& in, const vector<shared_ptr<const Heightfield>>& heightfields)
+{
+	int32_t index = in.read<int32_t>();
+
+	if (index < -1 || index >= (int32_t)heightfields.size())
+		in.fail();
+
+	if (index < 0 || index >= (int32_t)heightfields.size())
+		return nullptr;
+
+	return heightfields[index];
+}
+
+void SceneSnapshot::writePlane(Writer& out, Plane& plane)
+{
+	out.write(plane.diffuseColor);
+	out.write(plane.spectralColor);
+	out.write(plane.getUpperLeftCorner());
+	out.write(plane.width);
+	out.write(plane.height);
+	out.write((int32_t)plane.axis);
+	out.write((uint8_t)plane.reflective);
+	out.write(plane.reflectance);
+}
+
+void SceneSnapshot::readPlane(Reader& in, Plane& plane)
+{
+	ofColor diffuseColor = in.read<ofColor>();
+	ofColor spectralColor = in.read<ofColor>();
+	glm::vec3 corner = in.read<glm::vec3>();
+	float width = in.read<float>();
+	float height = in.read<float>();
+	int32_t axis = in.read<int32_t>();
+	bool reflective = in.readBool();
+	float reflectance = in.read<float>();
+
+	//the constructor only sets up the normal and edges for the axes it knows about
+	if (axis < (int32_t)Plane::Axis::XY || axis > (int32_t)Plane::Axis::YZ)
+	{
+		in.fail();
+		axis = (int32_t)Plane::Axis::XY;
+	}
+
+	//only assigns the Plane part of subclasses, which fill in their own fields afterwards
+	plane = Plane(corner, width, height, (Plane::Axis)axis, diffuseColor, spectralColor, reflective, reflectance);
+}
+
+void SceneSnapshot::writeTexturedPlane(Writer& out, TexturedPlane& plane, map<Texture*, int>& textureIndices)
+{
+	writePlane(out, plane);
+	out.write(plane.maxU);
+	out.write(plane.maxV);
+	out.write(getSharedIndex(plane.texture, textureIndices));
+}
+
+void SceneSnapshot::readTexturedPlane(Reader& in, TexturedPlane& plane, const vector<shared_ptr<Texture>>& textures)
+{
+	readPlane(in, plane);
+	plane.maxU = in.read<float>();
+	plane.maxV = in.read<float>();
+	plane.texture = readTexture(in, textures);
+}
+
+bool SceneSnapshot::writeObject(Writer& out, SceneObject& object, SharedIndices& indices)
+{
+	map<Texture*, int>& textureIndices = indices.textures;
+
+	//subclasses have to be checked before the classes they inherit from
+	if (DisplacementPlane* plane = dynamic_cast<DisplacementPlane*>(&object))
+	{
+		out.write(ObjectType::DISPLACEMENT_PLANE);
+		writeTexturedPlane(out, *plane, textureIndices);
+		out.write(getSharedIndex(plane->normalMap, textureIndices));
+		out.write(getSharedIndex(plane->displacementMap, textureIndices));
+		out.write(plane->displacementDepth);
+		out.write((uint8_t)plane->calculateNormal);
+		//a plane without a displacement map has no heightfield, and planes that share one share it in the file too
+		out.write(getSharedIndex(plane->heightfield, indices.heightfields));
+	}
+	else if (NormalPlane* plane = dynamic_cast<NormalPlane*>(&object))
+	{
+		out.write(ObjectType::NORMAL_PLANE);
+		writeTexturedPlane(out, *plane, textureIndices);
+		out.write(getSharedIndex(plane->normalMap, textureIndices));
+	}
+	else if (TexturedPlane* plane = dynamic_cast<TexturedPlane*>(&object))
+	{
+		out.write(ObjectType::TEXTURED_PLANE);
+		writeTexturedPlane(out, *plane, textureIndices);
+	}
+	else if (ReflectivePlane* plane = dynamic_cast<ReflectivePlane*>(&object))
+	{
+		out.write(ObjectType::REFLECTIVE_PLANE);
+		writePlane(out, *plane);
+		out.write(plane->ReflectivePlane::reflectance);
+	}
+	else if (Plane* plane = dynamic_cast<Plane*>(&object))
+	{
+		out.write(ObjectType::PLANE);
+		writePlane(out, *plane);
+	}
+	else if (Sphere* sphere = dynamic_cast<Sphere*>(&object))
+	{
+		TexturedSphere* texturedSphere = dynamic_cast<TexturedSphere*>(&object);
+
+		if (texturedSphere != nullptr)
+			out.write(ObjectType::TEXTURED_SPHERE);
+		else if (dynamic_cast<TransparentSphere*>(&object) != nullptr)
+			out.write(ObjectType::TRANSPARENT_SPHERE);
+		else
+			out.write(ObjectType::SPHERE);
+
+		out.write(sphere->diffuseColor);
+		out.write(sphere->spectralColor);
+		out.write(sphere->center);
+		out.write(sphere->radius);
+		out.write(sphere->theta);
+		out.write(sphere->phi);
+
+		if (texturedSphere != nullptr)
+			out.write(getSharedIndex(texturedSphere->texture, textureIndices));
+	}
+	else if (Box* box = dynamic_cast<Box*>(&object))
+	{
+		TexturedBox* texturedBox = dynamic_cast<TexturedBox*>(&object);
+
+		out.write(texturedBox != nullptr ? ObjectType::TEXTURED_BOX : ObjectType::BOX);
+		out.write(box->diffuseColor);
+		out.write(box->spectralColor);
+
+		out.write(box->minCorner);
+		out.write(box->maxCorner);
+
+		if (texturedBox != nullptr)
+		{
+			out.write(getSharedIndex(texturedBox->texture, textureIndices));
+			out.write(texturedBox->maxU);
+			out.write(texturedBox->maxV);
+		}
+	}
+	else if (Instance* instance = dynamic_cast<Instance*>(&object))
+	{
+		out.write(ObjectType::INSTANCE);
+		out.write(instance->objectToWorld);
+
+		SceneObject* instanced = instance->object.get();
+		auto existing = indices.instancedObjects.find(instanced);
+
+		if (existing != indices.instancedObjects.end())
+			out.write((int32_t)existing->second);
+		else
+		{
+			int32_t index = indices.instancedObjects.size();
+			indices.instancedObjects[instanced] = index;
+			out.write(index);
+
+			if (!writeObject(out, *instanced, indices))
+				return false;
+		}
+	}
+	else
+	{
+		ofLogError("SceneSnapshot") << "can't bake an object of type " << typeid(object).name();
+		return false;
+	}
+
+	return true;
+}
+
+shared_ptr<SceneObject> SceneSnapshot::readObject(Reader& in, SharedObjects& shared, int instanceDepth)
+{
+	const vector<shared_ptr<Texture>>& textures = shared.textures;
+	vector<shared_ptr<SceneObject>>& instancedObjects = shared.instancedObjects;
+
+	ObjectType type = in.read<ObjectType>();
+
+	switch (type)
+	{
+	case ObjectType::SPHERE:
+	case ObjectType::TEXTURED_SPHERE:
+	case ObjectType::TRANSPARENT_SPHERE:
+	{
+		shared_ptr<Sphere> sphere;
+
+		if (type == ObjectType::TEXTURED_SPHERE)
+			sphere = make_shared<TexturedSphere>();
+		else if (type == ObjectType::TRANSPARENT_SPHERE)
+			sphere = make_shared<TransparentSphere>();
+		else
+			sphere = make_shared<Sphere>();
+
+		sphere->diffuseColor = in.read<ofColor>();
+		sphere->spectralColor = in.read<ofColor>();
+		sphere->center = in.read<glm::vec3>();
+		sphere->radius = in.read<float>();
+		sphere->theta = in.read<float>();
+		sphere->phi = in.read<float>();
+
+		if (type == ObjectType::TEXTURED_SPHERE)
+			static_pointer_cast<TexturedSphere>(sphere)->texture = readTexture(in, textures);
+
+		return sphere;
+	}
+	case ObjectType::PLANE:
+	{
+		shared_ptr<Plane> plane = make_shared<Plane>();
+		readPlane(in, *plane);
+		return plane;
+	}
+	case ObjectType::REFLECTIVE_PLANE:
+	{
+		shared_ptr<ReflectivePlane> plane = make_shared<ReflectivePlane>();
+		readPlane(in, *plane);
+		plane->ReflectivePlane::reflectance = in.read<float>();
+		return plane;
+	}
+	case ObjectType::TEXTURED_PLANE:
+	{
+		shared_ptr<TexturedPlane> plane = make_shared<TexturedPlane>();
+		readTexturedPlane(in, *plane, textures);
+		return plane;
+	}
+	case ObjectType::NORMAL_PLANE:
+	{
+		shared_ptr<NormalPlane> plane = make_shared<NormalPlane>();
+		readTexturedPlane(in, *plane, textures);
+		plane->normalMap = readTexture(in, textures);
+		return plane;
+	}
+	case ObjectType::DISPLACEMENT_PLANE:
+	{
+		//the default constructor is used so that the displacement map isn't read again; the heightfield was already loaded from the file
+		shared_ptr<DisplacementPlane> plane = make_shared<DisplacementPlane>();
+		readTexturedPlane(in, *plane, textures);
+		plane->normalMap = readTexture(in, textures);
+		plane->displacementMap = readTexture(in, textures);
+		plane->displacementDepth = in.read<float>();
+		plane->calculateNormal = in.readBool();
+		plane->heightfield = readHeightfield(in, shared.heightfields);
+		return plane;
+	}
+	case ObjectType::BOX:
+	case ObjectType::TEXTURED_BOX:
+	{
+		ofColor diffuseColor = in.read<ofColor>();
+		ofColor spectralColor = in.read<ofColor>();
+		glm::vec3 minCorner = in.read<glm::vec3>();
+		glm::vec3 maxCorner = in.read<glm::vec3>();
+
+		shared_ptr<Box> box;
+
+		if (type == ObjectType::TEXTURED_BOX)
+		{
+			//the constructor works out how the texture is scaled on each face
+			shared_ptr<Texture> texture = readTexture(in, textures);
+			float maxU = in.read<float>();
+			float maxV = in.read<float>();
+
+			box = make_shared<TexturedBox>(minCorner, maxCorner, maxU, maxV, texture);
+		}
+		else
+			box = make_shared<Box>(minCorner, maxCorner, diffuseColor);
+
+		box->diffuseColor = diffuseColor;
+		box->spectralColor = spectralColor;
+
+		return box;
+	}
+	case ObjectType::INSTANCE:
+	{
+		glm::mat4 objectToWorld = in.read<glm::mat4>();
+		int32_t index = in.read<int32_t>();
+
+		shared_ptr<SceneObject> object;
+
+		//an index one past the objects read so far is a new one, which comes next in the file
+		if (index >= 0 && index < (int32_t)instancedObjects.size())
+			object = instancedObjects[index];
+		else if (index == (int32_t)instancedObjects.size() && instanceDepth < MAX_INSTANCE_DEPTH && !in.hasFailed())
+		{
+			instancedObjects.push_back(nullptr);
+			object = readObject(in, shared, instanceDepth + 1);
+			instancedObjects[index] = object;
+		}
+
+		if (object == nullptr)
+			return nullptr;
+
+		return make_shared<Instance>(object, objectToWorld);
+	}
+	}
+
+	return nullptr;
+}
+
+//--------------------------------------------------------------
+
+bool SceneSnapshot::bake(Scene& scene, const string& path)
+{
+	scene.finalize();
+
+	Writer out(path);
+	if (!out.isGood())
+	{
+		ofLogError("SceneSnapshot") << "couldn't open " << path << " for writing";
+		return false;
+	}
+
+	SnapshotHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.byteOrderMark = BYTE_ORDER_MARK;
+	header.headerSize = sizeof(SnapshotHeader);
+	header.bvhNodeSize = sizeof(BVH::Node);
+
+	//the real header is written at the end, once the section offsets are known
+	out.write(header);
+
+	//textures and heightfields are numbered as the objects that use them are written, and saved after all of the objects
+	SharedIndices indices;
+
+	header.objectsOffset = out.getPosition();
+	out.write((uint64_t)scene.surfaces.size());
+
+	for (shared_ptr<SceneObject>& object : scene.surfaces)
+	{
+		if (!writeObject(out, *object, indices))
+			return false;
+	}
+
+	header.lightsOffset = out.getPosition();
+	out.write((uint64_t)scene.lights.size());
+
+	for (shared_ptr<Light>& light : scene.lights)
+	{
+		Spotlight* spotlight = dynamic_cast<Spotlight*>(light.get());
+
+		out.write(spotlight != nullptr ? LightType::SPOTLIGHT : LightType::POINT);
+		out.write(light->origin);
+		out.write(light->luminosity);
+
+		if (spotlight != nullptr)
+		{
+			out.write(spotlight->direction);
+			out.write(spotlight->coneAngle);
+		}
+	}
+
+	header.accelerationOffset = out.getPosition();
+	out.writeArray(scene.transparentSurfaces.data(), scene.transparentSurfaces.size());
+	out.writeArray(scene.opaqueSurfaces.nodes.data(), scene.opaqueSurfaces.nodes.size());
+	out.writeArray(scene.opaqueSurfaces.leafObjects.data(), scene.opaqueSurfaces.leafObjects.size());
+
+	vector<Texture*> textures(indices.textures.size());
+	for (auto& texture : indices.textures)
+		textures[texture.second] = texture.first;
+
+	header.texturesOffset = out.getPosition();
+	out.write((uint64_t)textures.size());
+
+	for (Texture* texture : textures)
+	{
+		out.write((uint32_t)texture->width);
+		out.write((uint32_t)texture->height);
+		out.write(texture->encoding);
+		out.write(texture->filter);
+		out.writeArray(texture->texels, (uint64_t)texture->width * texture->height);
+	}
+
+	vector<const Heightfield*> heightfields(indices.heightfields.size());
+	for (auto& heightfield : indices.heightfields)
+		heightfields[heightfield.second] = heightfield.first;
+
+	header.heightfieldsOffset = out.getPosition();
+	out.write((uint64_t)heightfields.size());
+
+	//the mipmap is quick to rebuild, so only the heights are stored
+	for (const Heightfield* heightfield : heightfields)
+	{
+		out.write((int32_t)heightfield->gridWidth);
+		out.write((int32_t)heightfield->gridHeight);
+		out.writeArray(heightfield->heights.data(), heightfield->heights.size());
+	}
+
+	header.fileSize = out.getPosition();
+	out.writeHeaderAt(header);
+
+	if (!out.isGood())
+	{
+		ofLogError("SceneSnapshot") << "couldn't write " << path;
+		return false;
+	}
+
+	return true;
+}
+
+bool SceneSnapshot::load(const string& path, Scene& scene)
+{
+	if (!scene.surfaces.empty() || !scene.lights.empty())
+	{
+		ofLogError("SceneSnapshot") << "snapshots can only be loaded into an empty scene";
+		return false;
+	}
+
+	//the textures keep the mapping alive, since their texels point straight into it
+	shared_ptr<MappedFile> file = make_shared<MappedFile>();
+
+	if (!file->open(path))
+	{
+		ofLogError("SceneSnapshot") << "couldn't open " << path;
+		return false;
+	}
+
+	Reader in(file->getData(), file->getSize());
+	SnapshotHeader header = in.read<SnapshotHeader>();
+
+	if (in.hasFailed() || memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+	{
+		ofLogError("SceneSnapshot") << path << " isn't a baked scene";
+		return false;
+	}
+
+	if (header.version != VERSION || header.byteOrderMark != BYTE_ORDER_MARK || header.headerSize != sizeof(SnapshotHeader)
+		|| header.bvhNodeSize != sizeof(BVH::Node) || header.fileSize != file->getSize())
+	{
+		ofLogError("SceneSnapshot") << path << " was baked by a different version of the ray tracer (or is truncated), so it has to be baked again";
+		return false;
+	}
+
+	SharedObjects shared;
+
+	in.seek(header.texturesOffset);
+	uint64_t numTextures = in.read<uint64_t>();
+
+	for (uint64_t i = 0; i < numTextures && !in.hasFailed(); i++)
+	{
+		uint32_t width = in.read<uint32_t>();
+		uint32_t height = in.read<uint32_t>();
+		Texture::Encoding encoding = in.read<Texture::Encoding>();
+		Texture::Filter filter = in.read<Texture::Filter>();
+
+		uint64_t numTexels;
+		glm::vec4* texels = in.readArray<glm::vec4>(numTexels);
+
+		if (texels == nullptr || numTexels != (uint64_t)width * height || width == 0 || height == 0 || encoding > Texture::Encoding::NORMAL || filter > Texture::Filter::BILINEAR)
+		{
+			ofLogError("SceneSnapshot") << "texture " << i << " in " << path << " is corrupt";
+			return false;
+		}
+
+		//the texels are used straight out of the mapped file, which stays open for as long as the texture is around
+		shared_ptr<Texture> texture = make_shared<Texture>(texels, width, height, encoding, filter, file);
+
+		shared.textures.push_back(texture);
+	}
+
+	in.seek(header.heightfieldsOffset);
+	uint64_t numHeightfields = in.read<uint64_t>();
+
+	for (uint64_t i = 0; i < numHeightfields && !in.hasFailed(); i++)
+	{
+		int32_t gridWidth = in.read<int32_t>();
+		int32_t gridHeight = in.read<int32_t>();
+		vector<float> heights;
+		in.readVector(heights);
+
+		if (in.hasFailed() || gridWidth <= 0 || gridHeight <= 0 || heights.size() != ((size_t)gridWidth + 1) * ((size_t)gridHeight + 1))
+		{
+			ofLogError("SceneSnapshot") << "heightfield " << i << " in " << path << " is corrupt";
+			return false;
+		}
+
+		shared.heightfields.push_back(make_shared<Heightfield>(gridWidth, gridHeight, std::move(heights)));
+	}
+
+	in.seek(header.objectsOffset);
+	uint64_t numObjects = in.read<uint64_t>();
+
+	for (uint64_t i = 0; i < numObjects && !in.hasFailed(); i++)
+	{
+		shared_ptr<SceneObject> object = readObject(in, shared);
+
+		if (object == nullptr)
+		{
+			ofLogError("SceneSnapshot") << "object " << i << " in " << path << " has an unknown type or is corrupt";
+			scene.surfaces.clear();
+			return false;
+		}
+
+		scene.surfaces.push_back(object);
+	}
+
+	in.seek(header.lightsOffset);
+	uint64_t numLights = in.read<uint64_t>();
+
+	for (uint64_t i = 0; i < numLights && !in.hasFailed(); i++)
+	{
+		LightType type = in.read<LightType>();
+		glm::vec3 origin = in.read<glm::vec3>();
+		float luminosity = in.read<float>();
+
+		if (type == LightType::SPOTLIGHT)
+		{
+			glm::vec3 direction = in.read<glm::vec3>();
+			float coneAngle = in.read<float>();
+			scene.lights.push_back(make_shared<Spotlight>(origin, luminosity, direction, coneAngle));
+		}
+		else if (type == LightType::POINT)
+		{
+			scene.lights.push_back(make_shared<Light>(origin, luminosity));
+		}
+		else
+		{
+			in.fail();
+		}
+	}
+
+	in.seek(header.accelerationOffset);
+	in.readVector(scene.transparentSurfaces);
+	in.readVector(scene.opaqueSurfaces.nodes);
+	in.readVector(scene.opaqueSurfaces.leafObjects);
+
+	//the BVH is traversed straight from the file, so every index in it is checked first. A file of the right size can still hold indices
+	//that point outside the objects or the nodes (or back up the tree, which traversal would never get out of)
+	int numSurfaces = scene.surfaces.size();
+	int numNodes = scene.opaqueSurfaces.nodes.size();
+	int numLeafObjects = scene.opaqueSurfaces.leafObjects.size();
+	bool accelerationValid = true;
+
+	for (int objectIndex : scene.transparentSurfaces)
+		accelerationValid = accelerationValid && objectIndex >= 0 && objectIndex < numSurfaces;
+
+	for (int objectIndex : scene.opaqueSurfaces.leafObjects)
+		accelerationValid = accelerationValid && objectIndex >= 0 && objectIndex < numSurfaces;
+
+	//traversal keeps the nodes it still has to visit on a fixed size stack, which only has room for trees as deep as the ones BVH builds.
+	//Children always come after their parents, so one pass in order finds every node's depth
+	vector<int> depths(numNodes, 0);
+
+	for (int i = 0; i < numNodes && accelerationValid; i++)
+	{
+		const BVH::Node& node = scene.opaqueSurfaces.nodes[i];
+
+		if (node.numObjects > 0)
+			accelerationValid = node.offset >= 0 && node.offset <= numLeafObjects - node.numObjects;
+		else
+			accelerationValid = node.numObjects == 0 && node.axis >= 0 && node.axis < 3 && node.offset > i + 1 && node.offset < numNodes;
+
+		accelerationValid = accelerationValid && depths[i] <= BVH::MAX_DEPTH;
+
+		if (accelerationValid && node.numObjects == 0)
+		{
+			depths[i + 1] = max(depths[i + 1], depths[i] + 1);
+			depths[node.offset] = max(depths[node.offset], depths[i] + 1);
+		}
+	}
+
+	if (in.hasFailed() || !accelerationValid)
+	{
+		ofLogError("SceneSnapshot") << path << " is corrupt";
+		scene.surfaces.clear();
+		scene.lights.clear();
+		return false;
+	}
+
+	scene.opaqueSurfaces.objects = &scene.surfaces;
+	scene.opaqueSurfaces.copyShapes();
+
+	//the light tree is quick to build and lights are few, so it isn't saved
+	scene.finishFinalize();
+
+	return true;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Scene.h"
+
+class Plane;
+class TexturedPlane;
+struct Heightfield;
+
+/// <summary>
+/// Bakes a finalized scene (its objects, lights, converted textures, displacement heightfields and BVH) into a single binary file,
+/// and loads that file back by memory mapping it. Textures are used straight out of the mapped file, so loading a snapshot doesn't decode or convert any images,
+/// work out any displacement heights or rebuild the BVH. Textures and heightfields are stored once each, however many objects share them, and are shared again when loaded.
+/// Snapshots are only meant to be read by the same build that wrote them: they use the machine's native byte order and struct layout,
+/// and anything with a different version or layout is rejected.
+/// </summary>
+class SceneSnapshot
+{
+public:
+	static const uint32_t VERSION = 5;
+
+	/// <summary>
+	/// Writes the scene to the given path, finalizing it first if needed. Returns false if the file can't be written or the scene has something that can't be baked
+	/// </summary>
+	static bool bake(Scene& scene, const string& path);
+
+	/// <summary>
+	/// Loads a baked scene into an empty scene, which is finalized and ready to render when this returns true
+	/// </summary>
+	static bool load(const string& path, Scene& scene);
+
+private:
+	class Writer;
+	class Reader;
+
+	enum class ObjectType : uint32_t
+	{
+		SPHERE, TEXTURED_SPHERE, TRANSPARENT_SPHERE,
+		PLANE, REFLECTIVE_PLANE, TEXTURED_PLANE, NORMAL_PLANE, DISPLACEMENT_PLANE,
+		BOX, TEXTURED_BOX,
+		INSTANCE
+	};
+
+	//instances can be instanced themselves, but not deeper than this (which also stops a corrupt file from recursing forever)
+	static const int MAX_INSTANCE_DEPTH = 8;
+
+	enum class LightType : uint32_t { POINT, SPOTLIGHT };
+
+	//the numbers given to everything objects can share while they're written. Textures and heightfields are saved in their own sections after the objects,
+	//while the objects shared by instances are written in full right after the first instance that uses them
+	struct SharedIndices
+	{
+		map<Texture*, int> textures;
+		map<const Heightfield*, int> heightfields;
+		map<SceneObject*, int> instancedObjects;
+	};
+
+	//what those numbers refer to while the objects are read, with the textures and heightfields already loaded
+	struct SharedObjects
+	{
+		vector<shared_ptr<Texture>> textures;
+		vector<shared_ptr<const Heightfield>> heightfields;
+		vector<shared_ptr<SceneObject>> instancedObjects;
+	};
+
+	static bool writeObject(Writer& out, SceneObject& object, SharedIndices& indices);
+	static shared_ptr<SceneObject> readObject(Reader& in, SharedObjects& shared, int instanceDepth = 0);
+
+	//-1 stands for no texture. Any other index that isn't one of the textures fails the read, since the file must be corrupt
+	static shared_ptr<Texture> readTexture(Reader& in, const vector<shared_ptr<Texture>>& textures);
+	//the same for heightfields
+	static shared_ptr<const Heightfield> readHeightfield(Reader& in, const vector<shared_ptr<const Heightfield>>& heightfields);
+
+	static void writePlane(Writer& out, Plane& plane);
+	static void readPlane(Reader& in, Plane& plane);
+	static void writeTexturedPlane(Writer& out, TexturedPlane& plane, map<Texture*, int>& textureIndices);
+	static void readTexturedPlane(Reader& in, TexturedPlane& plane, const vector<shared_ptr<Texture>>& textures);
+};
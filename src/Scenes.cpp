@@ -0,0 +1,178 @@
+#include "Scenes.h"
+#include "PlaneObjects.h"
+#include "SphereObjects.h"
+#include "BoxObjects.h"
+#include "InstanceObjects.h"
+
+//--------------------------------------------------------------
+
+shared_ptr<Texture> loadTexture(const string& filename, Texture::Encoding encoding)
+{
+	ofPixels pixels;
+
+	//ofLoadImage only decodes the pixels, so there's no GL texture made (and there may not even be a GL context)
+	if (!ofLoadImage(pixels, filename))
+	{
+		ofLogError("loadTexture") << "couldn't load " << filename;
+		return nullptr;
+	}
+
+	return make_shared<Texture>(pixels, encoding);
+}
+
+//--------------------------------------------------------------
+
+static bool loadMoonScene(Scene& scene)
+{
+	shared_ptr<Texture> moonTex = loadTexture("moon_texture.jpg");
+	shared_ptr<Texture> waterTex = loadTexture("Water_001_COLOR.jpg");
+	shared_ptr<Texture> waterNormal = loadTexture("Water_001_NORM.jpg", Texture::Encoding::NORMAL);
+	shared_ptr<Texture> starTex = loadTexture("star.png");
+
+	if (moonTex == nullptr || waterTex == nullptr || waterNormal == nullptr || starTex == nullptr)
+		return false;
+
+	NormalPlane water(glm::vec3(-50, 0, -50), 100, 100, Plane::Axis::XZ, 20, 20, waterTex, waterNormal);
+	TexturedPlane stars(glm::vec3(-192, 180, -170), 384, 216, Plane::Axis::XY, 1, 1, starTex);
+	water.setReflective(true);
+	water.setReflectance(.5);
+	TexturedSphere moon(glm::vec3(0, 15, -100), 7, moonTex, ofColor::black, ofDegToRad(90));
+
+	TransparentSphere halo(glm::vec3(0, 13.5, -90), 12, ofColor(255, 255, 255, 100));
+
+	Spotlight light(glm::vec3(0, 15, -55), 550, glm::vec3(0, 0, -1), ofDegToRad(45));
+
+	scene.addSceneObject(water);
+	scene.addSceneObject(stars);
+	scene.addSceneObject(moon);
+	scene.addSceneObject(halo);
+
+	scene.addLight(light);
+
+	return true;
+}
+
+//a grid of spheres and boxes over a mirror, with a few transparent spheres in front. It needs no textures, and there is enough geometry and
+//enough reflections in it to show up changes to the BVH and to shading that the moon scene is too simple to notice
+static bool loadGalleryScene(Scene& scene)
+{
+	ReflectivePlane floor(glm::vec3(-40, -2, -60), 80, 80, Plane::Axis::XZ, .4, ofColor(90, 90, 100));
+	Plane backWall(glm::vec3(-40, 30, -60), 80, 32, Plane::Axis::XY, ofColor(60, 70, 90));
+	scene.addSceneObject(floor);
+	scene.addSceneObject(backWall);
+
+	for (int row = 0; row < 6; row++)
+	{
+		for (int column = 0; column < 8; column++)
+		{
+			glm::vec3 position(-14 + column * 4, 0, -8 - row * 5);
+			ofColor color = ofColor::fromHsb((row * 8 + column) * 5, 180, 220);
+
+			//alternate spheres and boxes like a checkerboard
+			if ((row + column) % 2 == 0)
+			{
+				Sphere sphere(position, 1.5, color);
+				scene.addSceneObject(sphere);
+			}
+			else
+			{
+				Box box(position + glm::vec3(-1.2, 1.2, -1.2), position + glm::vec3(1.2, -1.2, 1.2), color);
+				scene.addSceneObject(box);
+			}
+		}
+	}
+
+	for (int i = 0; i < 3; i++)
+	{
+		TransparentSphere glass(glm::vec3(-6 + i * 6, 1, -2), 2, ofColor(200, 230, 255, 90));
+		scene.addSceneObject(glass);
+	}
+
+	Light light(glm::vec3(-10, 20, 5), 700);
+	Spotlight spotlight(glm::vec3(10, 15, 0), 500, glm::normalize(glm::vec3(-.3, -.6, -1)), ofDegToRad(50));
+
+	scene.addLight(light);
+	scene.addLight(spotlight);
+
+	return true;
+}
+
+//a night street grid: blocks of buildings with a lamp post at every corner and along every street. There are hundreds of lights, but each point
+//on the ground is only reached by the few lamps above it, which is what the light culling in Scene is for
+static bool loadStreetScene(Scene& scene)
+{
+	const int NUM_BLOCKS = 6;
+	const float BLOCK_SIZE = 24;
+	const float STREET_WIDTH = 8;
+	const float LAMP_SPACING = 8;
+	const float LAMP_HEIGHT = 6;
+	const float gridSize = NUM_BLOCKS * (BLOCK_SIZE + STREET_WIDTH) + STREET_WIDTH;
+	const float gridStart = -gridSize / 2;
+
+	Plane ground(glm::vec3(gridStart, 0, gridStart), gridSize, gridSize, Plane::Axis::XZ, ofColor(70, 70, 75));
+	scene.addSceneObject(ground);
+
+	for (int row = 0; row < NUM_BLOCKS; row++)
+	{
+		for (int column = 0; column < NUM_BLOCKS; column++)
+		{
+			glm::vec3 corner(gridStart + STREET_WIDTH + column * (BLOCK_SIZE + STREET_WIDTH), 0, gridStart + STREET_WIDTH + row * (BLOCK_SIZE + STREET_WIDTH));
+			float height = 6 + ((row * 7 + column * 3) % 5) * 4;
+
+			//a border of pavement around each building
+			Box building(corner + glm::vec3(2, height, 2), corner + glm::vec3(BLOCK_SIZE - 2, 0, BLOCK_SIZE - 2), ofColor::fromHsb((row * NUM_BLOCKS + column) * 7, 60, 150));
+			scene.addSceneObject(building);
+		}
+	}
+
+	//every lamp post is an instance of the same post, turned to stand beside the lamp along its street
+	shared_ptr<Box> post = make_shared<Box>(glm::vec3(.5, LAMP_HEIGHT + .3, -.1), glm::vec3(.7, 0, .1), ofColor(40, 40, 45));
+	glm::mat4 turnToZ = glm::rotate(glm::mat4(1), ofDegToRad(90), glm::vec3(0, 1, 0));
+
+	//lamps down the middle of every street in both directions, pointing straight down
+	for (int street = 0; street <= NUM_BLOCKS; street++)
+	{
+		float streetCenter = gridStart + STREET_WIDTH / 2 + street * (BLOCK_SIZE + STREET_WIDTH);
+
+		for (float along = gridStart + STREET_WIDTH / 2; along <= gridStart + gridSize; along += LAMP_SPACING)
+		{
+			Spotlight alongX(glm::vec3(along, LAMP_HEIGHT, streetCenter), 30, glm::vec3(0, -1, 0), ofDegToRad(100));
+			scene.addLight(alongX);
+
+			Instance alongXPost(post, glm::translate(glm::mat4(1), glm::vec3(along, 0, streetCenter)));
+			scene.addSceneObject(alongXPost);
+
+			//the crossings already have a lamp from the streets running along x
+			if (fmod(along - gridStart - STREET_WIDTH / 2, BLOCK_SIZE + STREET_WIDTH) != 0)
+			{
+				Spotlight alongZ(glm::vec3(streetCenter, LAMP_HEIGHT, along), 30, glm::vec3(0, -1, 0), ofDegToRad(100));
+				scene.addLight(alongZ);
+
+				Instance alongZPost(post, glm::translate(glm::mat4(1), glm::vec3(streetCenter, 0, along)) * turnToZ);
+				scene.addSceneObject(alongZPost);
+			}
+		}
+	}
+
+	return true;
+}
+
+//--------------------------------------------------------------
+
+bool loadSceneByName(const string& name, Scene& scene)
+{
+	if (name == "moon")
+		return loadMoonScene(scene);
+	if (name == "gallery")
+		return loadGalleryScene(scene);
+	if (name == "street")
+		return loadStreetScene(scene);
+
+	ofLogError("loadSceneByName") << "there is no scene named " << name;
+	return false;
+}
+
+vector<string> getSceneNames()
+{
+	return { "moon", "gallery", "street" };
+}
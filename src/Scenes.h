@@ -0,0 +1,22 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Scene.h"
+#include "Texture.h"
+
+/**
+ * The built-in scenes, shared by the interactive app and the batch renderer
+ */
+
+/// <summary>
+/// Adds the objects and lights of the named scene to the given scene. Returns false if there is no scene with that name or one of its textures can't be loaded
+/// </summary>
+bool loadSceneByName(const string& name, Scene& scene);
+
+vector<string> getSceneNames();
+
+/// <summary>
+/// Loads an image and converts it into a texture (use Texture::Encoding::NORMAL for normal maps). No GL texture is made, so this works without a window.
+/// Returns nullptr if the image can't be loaded
+/// </summary>
+shared_ptr<Texture> loadTexture(const string& filename, Texture::Encoding encoding = Texture::Encoding::COLOR);
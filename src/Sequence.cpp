@@ -0,0 +1,270 @@
+#include "Sequence.h"
+#include "InstanceObjects.h"
+#include <future>
+#include <chrono>
+
+//--------------------------------------------------------------
+
+static bool parseVec3(const string& text, glm::vec3& value)
+{
+	vector<string> values = ofSplitString(text, ",");
+
+	if (values.size() != 3)
+		return false;
+
+	for (int i = 0; i < 3; i++)
+		value[i] = ofToFloat(values[i]);
+
+	return true;
+}
+
+/// <summary>
+/// Finds the keyframes on either side of time in keyframes (which is sorted by time and not empty), and how far time is from before to after, from 0 to 1.
+/// Times outside of the keyframes get the first or last keyframe as both
+/// </summary>
+template<typename Keyframe>
+static void findKeyframes(const vector<Keyframe>& keyframes, float time, const Keyframe*& before, const Keyframe*& after, float& fraction)
+{
+	auto next = std::upper_bound(keyframes.begin(), keyframes.end(), time, [](float time, const Keyframe& keyframe) { return time < keyframe.time; });
+
+	after = next == keyframes.end() ? &keyframes.back() : &*next;
+	before = next == keyframes.begin() ? &keyframes.front() : &*(next - 1);
+
+	fraction = after->time > before->time ? (time - before->time) / (after->time - before->time) : 0;
+}
+
+bool Sequence::load(const string& path)
+{
+	ifstream in(path);
+
+	if (!in)
+	{
+		ofLogError("Sequence") << "couldn't open " << path;
+		return false;
+	}
+
+	cameraKeyframes.clear();
+	objectKeyframes.clear();
+	attachedTransforms.clear();
+
+	bool hasKeyframes = false;
+	string line;
+
+	for (int lineNumber = 1; getline(in, line); lineNumber++)
+	{
+		line = ofTrim(line);
+
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		vector<string> tokens = ofSplitString(line, " ", true, true);
+		bool valid = false;
+		float time = 0;
+
+		if (tokens[0] == "camera" && (tokens.size() == 3 || tokens.size() == 4))
+		{
+			CameraKeyframe keyframe;
+			time = keyframe.time = ofToFloat(tokens[1]);
+			keyframe.fov = tokens.size() == 4 ? ofToFloat(tokens[3]) : 0;
+
+			vector<string> values = ofSplitString(tokens[2], ",");
+			valid = values.size() == 6 && keyframe.fov >= 0 && keyframe.fov < 180;
+
+			if (valid)
+			{
+				for (int i = 0; i < 3; i++)
+				{
+					keyframe.position[i] = ofToFloat(values[i]);
+					keyframe.target[i] = ofToFloat(values[i + 3]);
+				}
+
+				valid = keyframe.position != keyframe.target;
+
+				if (valid)
+					cameraKeyframes.push_back(keyframe);
+			}
+		}
+		else if (tokens[0] == "object" && tokens.size() >= 4 && tokens.size() <= 6)
+		{
+			int index = ofToInt(tokens[1]);
+
+			ObjectKeyframe keyframe;
+			time = keyframe.time = ofToFloat(tokens[2]);
+			keyframe.yaw = tokens.size() >= 5 ? ofDegToRad(ofToFloat(tokens[4])) : 0;
+			keyframe.scale = tokens.size() >= 6 ? ofToFloat(tokens[5]) : 1;
+
+			valid = index >= 0 && keyframe.scale > 0 && parseVec3(tokens[3], keyframe.offset);
+
+			if (valid)
+				objectKeyframes[index].push_back(keyframe);
+		}
+
+		if (!valid)
+		{
+			ofLogError("Sequence") << path << " line " << lineNumber << " isn't a keyframe: " << line;
+			return false;
+		}
+
+		startTime = hasKeyframes ? min(startTime, time) : time;
+		endTime = hasKeyframes ? max(endTime, time) : time;
+		hasKeyframes = true;
+	}
+
+	if (!hasKeyframes)
+	{
+		ofLogError("Sequence") << path << " doesn't have any keyframes";
+		return false;
+	}
+
+	//keyframes can be written in any order; ones at the same time keep their order, so the last one wins
+	auto byTime = [](const auto& a, const auto& b) { return a.time < b.time; };
+	std::stable_sort(cameraKeyframes.begin(), cameraKeyframes.end(), byTime);
+
+	for (auto& object : objectKeyframes)
+		std::stable_sort(object.second.begin(), object.second.end(), byTime);
+
+	return true;
+}
+
+bool Sequence::attach(Scene& scene)
+{
+	attachedTransforms.clear();
+
+	for (auto& object : objectKeyframes)
+	{
+		int index = object.first;
+		Instance* instance = index < scene.getNumObjects() ? dynamic_cast<Instance*>(scene.getObject(index).get()) : nullptr;
+
+		if (instance == nullptr)
+		{
+			ofLogError("Sequence") << "object " << index << " has keyframes, but " << (index < scene.getNumObjects() ? "it isn't an instance" : "the scene doesn't have that many objects");
+			return false;
+		}
+
+		attachedTransforms[index] = instance->getTransform();
+	}
+
+	return true;
+}
+
+float Sequence::getFrameTime(int frame, int numFrames) const
+{
+	return numFrames > 1 ? startTime + (endTime - startTime) * frame / (numFrames - 1) : startTime;
+}
+
+PinholeCamera Sequence::getCamera(float time, const CameraKeyframe& defaultCamera, int width, int height) const
+{
+	if (cameraKeyframes.empty())
+		return PinholeCamera(defaultCamera.position, defaultCamera.target, defaultCamera.fov, width, height);
+
+	const CameraKeyframe* before;
+	const CameraKeyframe* after;
+	float fraction;
+	findKeyframes(cameraKeyframes, time, before, after, fraction);
+
+	float beforeFov = before->fov > 0 ? before->fov : defaultCamera.fov;
+	float afterFov = after->fov > 0 ? after->fov : defaultCamera.fov;
+
+	return PinholeCamera(glm::mix(before->position, after->position, fraction), glm::mix(before->target, after->target, fraction),
+		glm::mix(beforeFov, afterFov, fraction), width, height);
+}
+
+void Sequence::moveObjects(Scene& scene, float time) const
+{
+	for (auto& object : objectKeyframes)
+	{
+		auto attached = attachedTransforms.find(object.first);
+		if (attached == attachedTransforms.end())
+			continue;
+
+		const ObjectKeyframe* before;
+		const ObjectKeyframe* after;
+		float fraction;
+		findKeyframes(object.second, time, before, after, fraction);
+
+		//turned and scaled around the object's own origin, and then moved by the offset
+		const glm::mat4& transform = attached->second;
+		glm::vec3 origin(transform[3]);
+
+		glm::mat4 motion = glm::translate(glm::mat4(1), origin + glm::mix(before->offset, after->offset, fraction));
+		motion = glm::rotate(motion, glm::mix(before->yaw, after->yaw, fraction), glm::vec3(0, 1, 0));
+		motion = glm::scale(motion, glm::vec3(glm::mix(before->scale, after->scale, fraction)));
+		motion = glm::translate(motion, -origin);
+
+		static_cast<Instance*>(scene.getObject(object.first).get())->setTransform(motion * transform);
+	}
+}
+
+//--------------------------------------------------------------
+
+string getFramePath(const string& outputPath, int frame)
+{
+	size_t extension = RenderStats::findExtension(outputPath);
+
+	return outputPath.substr(0, extension) + "_" + ofToString(frame, 4, '0') + outputPath.substr(extension);
+}
+
+//saves a frame and its statistics, returning false if the image couldn't be saved
+static bool saveFrame(const ofPixels& pixels, const RenderStats& stats, const string& path)
+{
+	if (!ofSaveImage(pixels, path))
+	{
+		cerr << "Couldn't save frame to " << path << endl;
+		return false;
+	}
+
+	//like a single render, a frame doesn't fail just because its statistics couldn't be saved
+	if (!stats.saveJson(RenderStats::pathForImage(path)))
+		cerr << "Couldn't save the render statistics for " << path << endl;
+
+	return true;
+}
+
+bool renderSequence(Scene& scene, const Sequence& sequence, const SequenceOptions& options)
+{
+	Renderer renderer(scene, options.renderSettings);
+
+	//the frame that is being saved while the next one is traced
+	std::future<bool> previousSave;
+	bool allSaved = true;
+
+	auto sequenceStart = std::chrono::steady_clock::now();
+
+	for (int frame = 0; frame < options.numFrames; frame++)
+	{
+		float time = sequence.getFrameTime(frame, options.numFrames);
+
+		auto refitStart = std::chrono::steady_clock::now();
+
+		//the first refit builds the BVH, since the scene hasn't been finalized yet
+		if (sequence.hasObjectKeyframes())
+		{
+			sequence.moveObjects(scene, time);
+			scene.refit();
+		}
+
+		double refitMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - refitStart).count();
+
+		ofPixels pixels = renderer.render(sequence.getCamera(time, options.defaultCamera, options.width, options.height));
+		string path = getFramePath(options.outputPath, frame);
+
+		cout << "Frame " << frame + 1 << " of " << options.numFrames << " (time " << time << "): traced in " << renderer.getStats().milliseconds << " ms";
+		if (sequence.hasObjectKeyframes())
+			cout << ", objects moved in " << fixed << setprecision(2) << refitMilliseconds << " ms" << defaultfloat;
+		cout << ", saving to " << path << endl;
+
+		//only one frame is saved at a time, so a slow disk can't pile up frames in memory
+		if (previousSave.valid())
+			allSaved = previousSave.get() && allSaved;
+
+		previousSave = std::async(std::launch::async, [pixels = std::move(pixels), stats = renderer.getStats(), path]() { return saveFrame(pixels, stats, path); });
+	}
+
+	if (previousSave.valid())
+		allSaved = previousSave.get() && allSaved;
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - sequenceStart).count();
+	cout << "Rendered " << options.numFrames << " frames in " << fixed << setprecision(2) << seconds << " s" << defaultfloat << endl;
+
+	return allSaved;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Scene.h"
+#include "Renderer.h"
+
+/**
+ * Renders the frames of a camera path (and of objects moving along their own paths) in one process, so that the scene's textures, BVH and light tree
+ * are only built once. Between frames the BVH is refit to the objects' new positions instead of being rebuilt, and each frame is saved on another thread
+ * while the next one is traced.
+ *
+ * Usage: moonlight-raytracer --scene street --sequence flythrough.txt --frames 120 --output frames/street.png
+ * Frames are saved with their number before the extension (frames/street_0000.png, frames/street_0001.png, ...).
+ *
+ * A sequence file has one keyframe per line (blank lines and lines starting with # are skipped):
+ *   camera TIME X,Y,Z,TX,TY,TZ [FOV]       the camera's position and the point it looks at, and optionally its field of view, at TIME
+ *   object INDEX TIME X,Y,Z [YAW [SCALE]]  how far the object at INDEX (counting from 0 in the order the scene adds them, which has to be an Instance)
+ *                                          has moved from where the scene put it at TIME, and how far it has turned (in degrees around the vertical axis)
+ *                                          and been scaled around its own origin
+ * Keyframes are interpolated linearly, and the frames are spread evenly from the earliest keyframe to the latest one
+ */
+
+struct CameraKeyframe
+{
+	float time;
+	glm::vec3 position;
+	glm::vec3 target;
+	float fov; //in degrees, or 0 to use the sequence's default
+};
+
+struct ObjectKeyframe
+{
+	float time;
+	glm::vec3 offset;
+	float yaw; //in radians
+	float scale;
+};
+
+class Sequence
+{
+public:
+	/// <summary>
+	/// Reads the keyframes from a sequence file. Returns false (after logging why) if the file can't be read or has a line that doesn't make sense
+	/// </summary>
+	bool load(const string& path);
+
+	/// <summary>
+	/// Checks that every keyframed object is an instance in the scene and remembers where the scene put each of them, which their keyframes are relative to.
+	/// Returns false (after logging why) if one isn't
+	/// </summary>
+	bool attach(Scene& scene);
+
+	float getStartTime() const { return startTime; }
+	float getEndTime() const { return endTime; }
+
+	//the time of frame number frame out of numFrames
+	float getFrameTime(int frame, int numFrames) const;
+
+	bool hasCameraKeyframes() const { return !cameraKeyframes.empty(); }
+	bool hasObjectKeyframes() const { return !objectKeyframes.empty(); }
+
+	/// <summary>
+	/// The camera at the given time. defaultCamera's position, target and field of view are used when there are no camera keyframes
+	/// (and its field of view when the keyframes don't give one)
+	/// </summary>
+	PinholeCamera getCamera(float time, const CameraKeyframe& defaultCamera, int width, int height) const;
+
+	/// <summary>
+	/// Moves every keyframed object of the scene that attach was called with to where it is at the given time. The scene has to be refit afterwards (see Scene::refit)
+	/// </summary>
+	void moveObjects(Scene& scene, float time) const;
+
+private:
+	vector<CameraKeyframe> cameraKeyframes; //sorted by time
+	map<int, vector<ObjectKeyframe>> objectKeyframes; //sorted by time, by object index
+	map<int, glm::mat4> attachedTransforms; //where the scene put each keyframed object
+
+	float startTime = 0;
+	float endTime = 0;
+};
+
+struct SequenceOptions
+{
+	string outputPath; //each frame is saved here, with its number added before the extension
+	int numFrames = 1;
+	int width = 0;
+	int height = 0;
+
+	CameraKeyframe defaultCamera; //see Sequence::getCamera
+	RenderSettings renderSettings;
+};
+
+/// <summary>
+/// Renders and saves every frame of the sequence, printing how long each one took. Returns false if any frame couldn't be saved
+/// </summary>
+bool renderSequence(Scene& scene, const Sequence& sequence, const SequenceOptions& options);
+
+/// <summary>
+/// Where frame number frame is saved: outputPath with the frame number (padded to at least four digits) added before its extension
+/// </summary>
+string getFramePath(const string& outputPath, int frame);
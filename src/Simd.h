@@ -0,0 +1,122 @@
+#pragma once
+
+/**
+ * A thin wrapper over the widest float vectors the compiler has been told it can use: AVX (8 lanes) if it is enabled, SSE (4 lanes) on any x86-64 build,
+ * and plain arrays everywhere else (ARM builds of openFrameworks, for example). Only the handful of operations the ray packet kernels need are wrapped.
+ * Comparisons return a mask with every bit of a lane set where the comparison is true, which can be combined with maskAnd/maskAndNot and turned into one bit per lane with moveMask
+ */
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SIMD_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIMD_SSE
+#else
+#include <cmath>
+#define SIMD_SCALAR
+#endif
+
+namespace simd
+{
+#if defined(SIMD_AVX)
+
+	const int WIDTH = 8;
+	typedef __m256 Floats;
+
+	inline Floats load(const float* p) { return _mm256_load_ps(p); }
+	inline void store(float* p, Floats a) { _mm256_store_ps(p, a); }
+	inline Floats set(float f) { return _mm256_set1_ps(f); }
+
+	inline Floats add(Floats a, Floats b) { return _mm256_add_ps(a, b); }
+	inline Floats sub(Floats a, Floats b) { return _mm256_sub_ps(a, b); }
+	inline Floats mul(Floats a, Floats b) { return _mm256_mul_ps(a, b); }
+	inline Floats div(Floats a, Floats b) { return _mm256_div_ps(a, b); }
+	inline Floats sqrt(Floats a) { return _mm256_sqrt_ps(a); }
+	inline Floats min(Floats a, Floats b) { return _mm256_min_ps(a, b); }
+	inline Floats max(Floats a, Floats b) { return _mm256_max_ps(a, b); }
+	inline Floats abs(Floats a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a); }
+
+	inline Floats less(Floats a, Floats b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	inline Floats lessEqual(Floats a, Floats b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+	inline Floats greater(Floats a, Floats b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	inline Floats greaterEqual(Floats a, Floats b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+
+	inline Floats maskAnd(Floats a, Floats b) { return _mm256_and_ps(a, b); }
+	inline Floats maskAndNot(Floats a, Floats b) { return _mm256_andnot_ps(b, a); } //a and not b
+	inline Floats select(Floats mask, Floats a, Floats b) { return _mm256_blendv_ps(b, a, mask); } //a where mask is set, b elsewhere
+	inline int moveMask(Floats mask) { return _mm256_movemask_ps(mask); }
+
+#elif defined(SIMD_SSE)
+
+	const int WIDTH = 4;
+	typedef __m128 Floats;
+
+	inline Floats load(const float* p) { return _mm_load_ps(p); }
+	inline void store(float* p, Floats a) { _mm_store_ps(p, a); }
+	inline Floats set(float f) { return _mm_set1_ps(f); }
+
+	inline Floats add(Floats a, Floats b) { return _mm_add_ps(a, b); }
+	inline Floats sub(Floats a, Floats b) { return _mm_sub_ps(a, b); }
+	inline Floats mul(Floats a, Floats b) { return _mm_mul_ps(a, b); }
+	inline Floats div(Floats a, Floats b) { return _mm_div_ps(a, b); }
+	inline Floats sqrt(Floats a) { return _mm_sqrt_ps(a); }
+	inline Floats min(Floats a, Floats b) { return _mm_min_ps(a, b); }
+	inline Floats max(Floats a, Floats b) { return _mm_max_ps(a, b); }
+	inline Floats abs(Floats a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a); }
+
+	inline Floats less(Floats a, Floats b) { return _mm_cmplt_ps(a, b); }
+	inline Floats lessEqual(Floats a, Floats b) { return _mm_cmple_ps(a, b); }
+	inline Floats greater(Floats a, Floats b) { return _mm_cmpgt_ps(a, b); }
+	inline Floats greaterEqual(Floats a, Floats b) { return _mm_cmpge_ps(a, b); }
+
+	inline Floats maskAnd(Floats a, Floats b) { return _mm_and_ps(a, b); }
+	inline Floats maskAndNot(Floats a, Floats b) { return _mm_andnot_ps(b, a); } //a and not b
+	inline Floats select(Floats mask, Floats a, Floats b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); } //SSE2 has no blend instruction
+	inline int moveMask(Floats mask) { return _mm_movemask_ps(mask); }
+
+#else
+
+	const int WIDTH = 4;
+
+	//comparison masks are stored as 0 or -1 reinterpreted as a float, so that only moveMask and select ever look at them
+	struct Floats { float v[WIDTH]; };
+
+	inline float maskValue(bool b) { union { int i; float f; } u; u.i = b ? -1 : 0; return u.f; }
+	inline bool isSet(float f) { union { int i; float f; } u; u.f = f; return u.i != 0; }
+
+	#define SIMD_LANEWISE(expression) Floats r; for (int i = 0; i < WIDTH; i++) r.v[i] = (expression); return r
+
+	inline Floats load(const float* p) { SIMD_LANEWISE(p[i]); }
+	inline void store(float* p, Floats a) { for (int i = 0; i < WIDTH; i++) p[i] = a.v[i]; }
+	inline Floats set(float f) { SIMD_LANEWISE(f); }
+
+	inline Floats add(Floats a, Floats b) { SIMD_LANEWISE(a.v[i] + b.v[i]); }
+	inline Floats sub(Floats a, Floats b) { SIMD_LANEWISE(a.v[i] - b.v[i]); }
+	inline Floats mul(Floats a, Floats b) { SIMD_LANEWISE(a.v[i] * b.v[i]); }
+	inline Floats div(Floats a, Floats b) { SIMD_LANEWISE(a.v[i] / b.v[i]); }
+	inline Floats sqrt(Floats a) { SIMD_LANEWISE(std::sqrt(a.v[i])); }
+	inline Floats min(Floats a, Floats b) { SIMD_LANEWISE(b.v[i] < a.v[i] ? b.v[i] : a.v[i]); }
+	inline Floats max(Floats a, Floats b) { SIMD_LANEWISE(b.v[i] > a.v[i] ? b.v[i] : a.v[i]); }
+	inline Floats abs(Floats a) { SIMD_LANEWISE(std::fabs(a.v[i])); }
+
+	inline Floats less(Floats a, Floats b) { SIMD_LANEWISE(maskValue(a.v[i] < b.v[i])); }
+	inline Floats lessEqual(Floats a, Floats b) { SIMD_LANEWISE(maskValue(a.v[i] <= b.v[i])); }
+	inline Floats greater(Floats a, Floats b) { SIMD_LANEWISE(maskValue(a.v[i] > b.v[i])); }
+	inline Floats greaterEqual(Floats a, Floats b) { SIMD_LANEWISE(maskValue(a.v[i] >= b.v[i])); }
+
+	inline Floats maskAnd(Floats a, Floats b) { SIMD_LANEWISE(maskValue(isSet(a.v[i]) && isSet(b.v[i]))); }
+	inline Floats maskAndNot(Floats a, Floats b) { SIMD_LANEWISE(maskValue(isSet(a.v[i]) && !isSet(b.v[i]))); }
+	inline Floats select(Floats mask, Floats a, Floats b) { SIMD_LANEWISE(isSet(mask.v[i]) ? a.v[i] : b.v[i]); }
+	inline int moveMask(Floats mask) { int bits = 0; for (int i = 0; i < WIDTH; i++) bits |= isSet(mask.v[i]) << i; return bits; }
+
+	#undef SIMD_LANEWISE
+
+#endif
+
+	//a moveMask result with every lane set
+	const int ALL_LANES = (1 << WIDTH) - 1;
+
+	//the number of lanes set in a moveMask result
+	inline int countLanes(int mask) { int count = 0; for (; mask != 0; mask &= mask - 1) count++; return count; }
+}
@@ -0,0 +1,257 @@
+#include "Socket.h"
+#include <cstring>
+#include <algorithm>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <unistd.h>
+#endif
+
+//--------------------------------------------------------------
+
+#ifdef _WIN32
+
+typedef SOCKET NativeSocket;
+static const NativeSocket NATIVE_INVALID = INVALID_SOCKET;
+static void closeNative(NativeSocket socket) { closesocket(socket); }
+static const int SEND_FLAGS = 0;
+
+//Winsock has to be started before any socket is made, and it's simplest to never stop it
+static bool startNetworking()
+{
+	static bool started = []()
+	{
+		WSADATA data;
+		return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+	}();
+
+	return started;
+}
+
+#else
+
+typedef int NativeSocket;
+static const NativeSocket NATIVE_INVALID = -1;
+static void closeNative(NativeSocket socket) { ::close(socket); }
+static bool startNetworking() { return true; }
+
+//writing to a connection the other end has closed should fail the send, not kill the process with SIGPIPE
+#ifdef MSG_NOSIGNAL
+static const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+static const int SEND_FLAGS = 0;
+#endif
+
+#endif
+
+static NativeSocket toNative(int64_t handle) { return handle == -1 ? NATIVE_INVALID : (NativeSocket)handle; }
+
+//how long a connection can be idle before keepalive probes start, how far apart they are, and how many can go unanswered before the connection is dropped
+static const int KEEPALIVE_IDLE_SECONDS = 30;
+static const int KEEPALIVE_INTERVAL_SECONDS = 10;
+static const int KEEPALIVE_PROBES = 3;
+
+//tiles are sent as soon as they're asked for, so small messages shouldn't wait to be combined. Keepalive probes are answered by the other machine
+//even while its process is busy rendering, so they only notice a machine that was turned off or cut off without closing the connection
+static void setConnectionOptions(NativeSocket native)
+{
+	int enable = 1;
+	setsockopt(native, IPPROTO_TCP, TCP_NODELAY, (const char*)&enable, sizeof(enable));
+	setsockopt(native, SOL_SOCKET, SO_KEEPALIVE, (const char*)&enable, sizeof(enable));
+
+	//the default idle time is usually two hours, which is much too long to leave a job with a machine that's gone
+#ifdef TCP_KEEPIDLE
+	int idle = KEEPALIVE_IDLE_SECONDS;
+	setsockopt(native, IPPROTO_TCP, TCP_KEEPIDLE, (const char*)&idle, sizeof(idle));
+#elif defined(TCP_KEEPALIVE)
+	int idle = KEEPALIVE_IDLE_SECONDS;
+	setsockopt(native, IPPROTO_TCP, TCP_KEEPALIVE, (const char*)&idle, sizeof(idle));
+#endif
+#ifdef TCP_KEEPINTVL
+	int interval = KEEPALIVE_INTERVAL_SECONDS;
+	setsockopt(native, IPPROTO_TCP, TCP_KEEPINTVL, (const char*)&interval, sizeof(interval));
+#endif
+#ifdef TCP_KEEPCNT
+	int probes = KEEPALIVE_PROBES;
+	setsockopt(native, IPPROTO_TCP, TCP_KEEPCNT, (const char*)&probes, sizeof(probes));
+#endif
+}
+
+//--------------------------------------------------------------
+
+Socket& Socket::operator=(Socket&& other)
+{
+	if (this != &other)
+	{
+		close();
+		handle = other.handle;
+		other.handle = INVALID;
+	}
+
+	return *this;
+}
+
+bool Socket::listen(int port)
+{
+	close();
+
+	if (!startNetworking())
+		return false;
+
+	NativeSocket native = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (native == NATIVE_INVALID)
+		return false;
+
+	//lets the port be used again right away by a coordinator that is started again
+	int reuse = 1;
+	setsockopt(native, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+
+	if (::bind(native, (sockaddr*)&address, sizeof(address)) != 0 || ::listen(native, SOMAXCONN) != 0)
+	{
+		closeNative(native);
+		return false;
+	}
+
+	handle = native;
+	return true;
+}
+
+bool Socket::accept(Socket& connection, int timeoutMilliseconds)
+{
+	if (!isOpen())
+		return false;
+
+	NativeSocket native = toNative(handle);
+
+	fd_set readable;
+	FD_ZERO(&readable);
+	FD_SET(native, &readable);
+
+	timeval timeout;
+	timeout.tv_sec = timeoutMilliseconds / 1000;
+	timeout.tv_usec = (timeoutMilliseconds % 1000) * 1000;
+
+	if (select((int)native + 1, &readable, nullptr, nullptr, &timeout) <= 0)
+		return false;
+
+	NativeSocket client = ::accept(native, nullptr, nullptr);
+	if (client == NATIVE_INVALID)
+		return false;
+
+	setConnectionOptions(client);
+
+	connection.close();
+	connection.handle = client;
+	return true;
+}
+
+bool Socket::connect(const std::string& host, int port)
+{
+	close();
+
+	if (!startNetworking())
+		return false;
+
+	addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	addrinfo* addresses = nullptr;
+	if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0)
+		return false;
+
+	for (addrinfo* address = addresses; address != nullptr; address = address->ai_next)
+	{
+		NativeSocket native = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+		if (native == NATIVE_INVALID)
+			continue;
+
+		if (::connect(native, address->ai_addr, (int)address->ai_addrlen) == 0)
+		{
+			setConnectionOptions(native);
+
+			handle = native;
+			break;
+		}
+
+		closeNative(native);
+	}
+
+	freeaddrinfo(addresses);
+	return isOpen();
+}
+
+bool Socket::sendAll(const void* data, size_t numBytes)
+{
+	const char* bytes = static_cast<const char*>(data);
+
+	while (numBytes > 0 && isOpen())
+	{
+		int sent = ::send(toNative(handle), bytes, (int)std::min(numBytes, (size_t)1 << 30), SEND_FLAGS);
+		if (sent <= 0)
+			return false;
+
+		bytes += sent;
+		numBytes -= sent;
+	}
+
+	return numBytes == 0;
+}
+
+bool Socket::receiveAll(void* data, size_t numBytes)
+{
+	char* bytes = static_cast<char*>(data);
+
+	while (numBytes > 0 && isOpen())
+	{
+		//0 means the other end closed the connection, and -1 that the receive failed or timed out
+		int received = ::recv(toNative(handle), bytes, (int)std::min(numBytes, (size_t)1 << 30), 0);
+		if (received <= 0)
+			return false;
+
+		bytes += received;
+		numBytes -= received;
+	}
+
+	return numBytes == 0;
+}
+
+bool Socket::setReceiveTimeout(int timeoutMilliseconds)
+{
+	if (!isOpen())
+		return false;
+
+#ifdef _WIN32
+	DWORD timeout = timeoutMilliseconds;
+#else
+	timeval timeout;
+	timeout.tv_sec = timeoutMilliseconds / 1000;
+	timeout.tv_usec = (timeoutMilliseconds % 1000) * 1000;
+#endif
+
+	return setsockopt(toNative(handle), SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout)) == 0;
+}
+
+void Socket::close()
+{
+	if (handle != INVALID)
+		closeNative(toNative(handle));
+
+	handle = INVALID;
+}
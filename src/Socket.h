@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+/// <summary>
+/// A blocking TCP connection (or listening socket), just enough for the tile coordinator and its workers to talk to each other.
+/// Sends and receives always move the whole buffer, or fail
+/// </summary>
+class Socket
+{
+public:
+	Socket() : handle(INVALID) {}
+	~Socket() { close(); }
+
+	Socket(const Socket&) = delete;
+	Socket& operator=(const Socket&) = delete;
+
+	Socket(Socket&& other) : handle(other.handle) { other.handle = INVALID; }
+	Socket& operator=(Socket&& other);
+
+	/// <summary>
+	/// Starts listening for connections on port, on every network interface
+	/// </summary>
+	bool listen(int port);
+
+	/// <summary>
+	/// Waits up to timeoutMilliseconds for a connection to a listening socket. Returns false if none came (or the socket is closed), so that callers can stop waiting
+	/// </summary>
+	bool accept(Socket& connection, int timeoutMilliseconds);
+
+	/// <summary>
+	/// Connects to host:port, trying every address the host name resolves to
+	/// </summary>
+	bool connect(const std::string& host, int port);
+
+	bool sendAll(const void* data, size_t numBytes);
+	bool receiveAll(void* data, size_t numBytes);
+
+	/// <summary>
+	/// Makes receives fail once nothing has arrived for timeoutMilliseconds (0 waits forever), so that a peer that stops answering can't block them for good
+	/// </summary>
+	bool setReceiveTimeout(int timeoutMilliseconds);
+
+	void close();
+	bool isOpen() const { return handle != INVALID; }
+
+private:
+	//a SOCKET on Windows and a file descriptor everywhere else, both of which fit in 64 bits
+	static const int64_t INVALID = -1;
+	int64_t handle;
+};
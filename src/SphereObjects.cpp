@@ -13,8 +13,9 @@ glm::vec2 Sphere::parameterizePoint(const glm::vec3& point)
 
 	//uses Spherical coordinate projection from https://people.cs.clemson.edu/~dhouse/courses/405/notes/texture-maps.pdf
 
+	//rounding can put y / radius just outside [-1, 1] at the poles, where acos would return NaN
 	float theta = atan2(-z, x) + this->theta;
-	float phi = acos(y / radius) + this->phi;
+	float phi = acos(glm::clamp(y / radius, -1.f, 1.f)) + this->phi;
 
 	float u = (theta + M_PI) / (2 * M_PI);
 	float v = phi / M_PI;
@@ -22,14 +23,40 @@ glm::vec2 Sphere::parameterizePoint(const glm::vec3& point)
 	return glm::vec2(u, v);
 }
 
+bool Sphere::intersects(const Ray& ray, HitRecord& hit)
+{
+	if (!Sphere::getShape().sphere.intersects(ray, hit.point, hit.distance))
+		return false;
+
+	hit.normal = (hit.point - center) / radius;
+	return true;
+}
+
+PrimitiveShape Sphere::getShape()
+{
+	PrimitiveShape shape;
+	shape.type = PrimitiveShape::Type::SPHERE;
+
+	for (int axis = 0; axis < 3; axis++)
+		shape.sphere.center[axis] = center[axis];
+
+	shape.sphere.radiusSquared = radius * radius;
+
+	return shape;
+}
+
 //--------------------------------------------------------------
 
-ofColor TexturedSphere::getDiffuseColor(const glm::vec3& point)
+bool TexturedSphere::intersects(const Ray& ray, HitRecord& hit)
 {
-	glm::vec2 parameterizedVec = parameterizePoint(point);
+	if (!Sphere::intersects(ray, hit))
+		return false;
 
-	int x = fmod(parameterizedVec[0] * texture->getWidth(), texture->getWidth());
-	int y = fmod(parameterizedVec[1] * texture->getHeight(), texture->getHeight());
+	hit.uv = parameterizePoint(hit.point);
+	return true;
+}
 
-	return texture->getColor(x, y);
+ofColor TexturedSphere::getDiffuseColor(const HitRecord& hit)
+{
+	return texture->sampleColor(hit.uv[0], hit.uv[1]);
 }
\ No newline at end of file
@@ -10,17 +10,18 @@ public:
 
 	virtual void draw() { ofSetColor(getDiffuseColor()); ofDrawSphere(center, radius); }
 
-	virtual bool intersects(const Ray& ray, glm::vec3& intersectPoint, glm::vec3& intersectNormal)
-	{
-		bool rayIntersects = glm::intersectRaySphere(ray.origin, ray.direction, center, radius, intersectPoint, intersectNormal);
-		if (glm::distance(ray.origin, intersectPoint) > ray.maxDistance)
-			rayIntersects = false;
+	virtual bool intersects(const Ray& ray, HitRecord& hit);
+	virtual bool occludes(const Ray& ray) { return Sphere::getShape().sphere.occludes(ray); }
+	virtual int intersectPacket(const RayPacket& packet, int laneMask, float* distances) { return Sphere::getShape().sphere.intersectPacket(packet, laneMask, distances); }
+	virtual PrimitiveShape getShape();
 
-		return rayIntersects;
-	}
+	virtual AABB getBounds() { return AABB(center - glm::vec3(radius), center + glm::vec3(radius)); }
+	virtual RenderStats::PrimitiveType getPrimitiveType() { return RenderStats::SPHERE; }
 
 	glm::vec2 parameterizePoint(const glm::vec3& point);
 
+	friend class SceneSnapshot; //reads and writes baked scene files
+
 private:
 	glm::vec3 center;
 	float radius;
@@ -33,12 +34,17 @@ class TexturedSphere : public Sphere
 {
 public:
 	TexturedSphere() : texture(nullptr) {} //default constructor for TexturedSphere
-	TexturedSphere(glm::vec3 center, float radius, shared_ptr<ofImage> texture, ofColor specularColor = ofColor::black, float theta = 0, float phi = 0)
+	TexturedSphere(glm::vec3 center, float radius, shared_ptr<Texture> texture, ofColor specularColor = ofColor::black, float theta = 0, float phi = 0)
 		: Sphere(center, radius, ofColor::darkGray, specularColor, theta, phi), texture(texture) {}
 
-	virtual ofColor getDiffuseColor(const glm::vec3& point);
+	//the texture coordinates take a couple of inverse trig functions, so only textured spheres work them out (once per hit)
+	virtual bool intersects(const Ray& ray, HitRecord& hit);
+	virtual ofColor getDiffuseColor(const HitRecord& hit);
+
+	friend class SceneSnapshot; //reads and writes baked scene files
+
 private:
-	shared_ptr<ofImage> texture;
+	shared_ptr<Texture> texture;
 };
 
 class TransparentSphere : public Sphere
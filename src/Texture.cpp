@@ -0,0 +1,85 @@
+#include "Texture.h"
+#include "RenderStats.h"
+#include <cmath>
+
+//--------------------------------------------------------------
+
+Texture::Texture(const ofPixels& pixels, Encoding encoding, Filter filter)
+	: width(pixels.getWidth()), height(pixels.getHeight()), encoding(encoding), filter(filter)
+{
+	storage.resize((size_t)width * height);
+
+	//this is the only place that goes through ofPixels, which takes care of the different pixel formats
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			ofColor color = pixels.getColor(x, y);
+			glm::vec4& texel = storage[(size_t)y * width + x];
+
+			if (encoding == Encoding::NORMAL)
+			{
+				//normal math taken from https://learnopengl.com/Advanced-Lighting/Normal-Mapping
+				texel = glm::vec4((color.r / 255.0) * 2 - 1, (color.g / 255.0) * 2 - 1, (color.b / 255.0) * 2 - 1, 0);
+			}
+			else
+			{
+				texel = glm::vec4(color.r, color.g, color.b, color.a);
+			}
+		}
+	}
+
+	texels = storage.data();
+}
+
+Texture::Texture(const glm::vec4* texels, int width, int height, Encoding encoding, Filter filter, shared_ptr<void> owner)
+	: width(width), height(height), encoding(encoding), filter(filter), texels(texels), owner(owner)
+{
+
+}
+
+//--------------------------------------------------------------
+
+//wraps a texel coordinate around to [0, size) without branching
+static inline int wrap(float coordinate, int size)
+{
+	int64_t wrapped = (int64_t)coordinate % size;
+	return (int)(wrapped + (wrapped < 0) * size);
+}
+
+glm::vec4 Texture::sample(float u, float v) const
+{
+	if (RenderStats* stats = RenderStats::current())
+		stats->textureSamples++;
+
+	//casting NaN or infinity to an integer is undefined, so a bad coordinate samples the texel at 0 instead
+	if (!std::isfinite(u))
+		u = 0;
+	if (!std::isfinite(v))
+		v = 0;
+
+	float x = u * width;
+	float y = v * height;
+
+	if (filter == Filter::NEAREST)
+		return getTexel(wrap(floor(x), width), wrap(floor(y), height));
+
+	//texel centers are halfway between whole coordinates, so shifting by half a texel puts the point between the four texels around it
+	x -= .5f;
+	y -= .5f;
+
+	float left = floor(x);
+	float top = floor(y);
+	float xWeight = x - left;
+	float yWeight = y - top;
+
+	int x0 = wrap(left, width);
+	int x1 = wrap(left + 1, width);
+	int y0 = wrap(top, height);
+	int y1 = wrap(top + 1, height);
+
+	glm::vec4 upper = glm::mix(getTexel(x0, y0), getTexel(x1, y0), xWeight);
+	glm::vec4 lower = glm::mix(getTexel(x0, y1), getTexel(x1, y1), xWeight);
+
+	return glm::mix(upper, lower, yWeight);
+}
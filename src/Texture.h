@@ -0,0 +1,56 @@
+#pragma once
+
+#include "ofMain.h"
+
+/// <summary>
+/// An image converted once, when it's loaded, into a tightly packed array of float texels so that shading never goes through ofImage::getColor.
+/// COLOR textures keep their channels in the 0-255 range that ofColor uses, and NORMAL textures (normal maps) are decoded up front into vectors with components between -1 and 1.
+/// Textures are shared between objects through shared_ptr and can't be copied, since their texels may live in memory they don't own (like a mapped snapshot file)
+/// </summary>
+class Texture
+{
+public:
+	enum class Encoding : uint32_t { COLOR, NORMAL };
+	enum class Filter : uint32_t { NEAREST, BILINEAR };
+
+	Texture() : width(0), height(0), encoding(Encoding::COLOR), filter(Filter::NEAREST), texels(nullptr) {}
+	Texture(const ofPixels& pixels, Encoding encoding = Encoding::COLOR, Filter filter = Filter::NEAREST);
+
+	/// <summary>
+	/// Uses texels that are owned by something else. owner is kept alive for as long as the texture is
+	/// </summary>
+	Texture(const glm::vec4* texels, int width, int height, Encoding encoding, Filter filter, shared_ptr<void> owner);
+
+	Texture(const Texture&) = delete;
+	Texture& operator=(const Texture&) = delete;
+
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+	Encoding getEncoding() const { return encoding; }
+
+	Filter getFilter() const { return filter; }
+	void setFilter(Filter filter) { this->filter = filter; }
+
+	const glm::vec4& getTexel(int x, int y) const { return texels[y * width + x]; }
+
+	/// <summary>
+	/// Samples the texture at (u, v), where [0, 1) covers the image once from its upper left corner and anything outside of that wraps around
+	/// </summary>
+	glm::vec4 sample(float u, float v) const;
+	glm::vec4 sample(const glm::vec2& uv) const { return sample(uv[0], uv[1]); }
+
+	ofColor sampleColor(float u, float v) const { glm::vec4 texel = sample(u, v); return ofColor(texel[0], texel[1], texel[2], texel[3]); }
+
+	glm::vec3 sampleNormal(float u, float v) const { return glm::vec3(sample(u, v)); }
+
+	friend class SceneSnapshot; //reads and writes baked scene files
+
+private:
+	int width, height;
+	Encoding encoding;
+	Filter filter;
+
+	vector<glm::vec4> storage; //empty when the texels are owned by something else
+	const glm::vec4* texels;
+	shared_ptr<void> owner;
+};
@@ -1,8 +1,13 @@
 #include "ofMain.h"
 #include "ofApp.h"
+#include "BatchRender.h"
 
 //========================================================================
-int main( ){
+int main(int argc, char* argv[]){
+	// any command line arguments mean a headless batch render: no window or GL context is created
+	if (argc > 1)
+		return runBatchRender(argc, argv);
+
 	//ofSetupOpenGL(1920,1080,OF_WINDOW);			// <-------- setup the GL context
 	ofSetupOpenGL(1200, 700, OF_WINDOW);
 	// this kicks off the running of my app
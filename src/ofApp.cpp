@@ -2,9 +2,7 @@
 #include <fstream>
 #include <iostream>
 #include <limits>
-#include <chrono>
-#include "PlaneObjects.h"
-#include "SphereObjects.h"
+#include "Scenes.h"
 #include <glm/gtx/intersect.hpp>
 
 /**
@@ -55,69 +53,72 @@ void ofApp::loadScene()
 {
 	whatToRender = RenderObjectType::SCENE;
 
-	shared_ptr<ofImage> moonTex = make_shared<ofImage>("moon_texture.jpg");
-	shared_ptr<ofImage> waterTex = make_shared<ofImage>("Water_001_COLOR.jpg");
-	shared_ptr<ofImage> waterNormal = make_shared<ofImage>("Water_001_NORM.jpg");
-	shared_ptr<ofImage> starTex = make_shared<ofImage>("star.png");
-
-	NormalPlane water(glm::vec3(-50, 0, -50), 100, 100, Plane::Axis::XZ, 20, 20, waterTex, waterNormal);
-	TexturedPlane stars(glm::vec3(-192, 180, -170), 384, 216, Plane::Axis::XY, 1, 1, starTex);
-	water.setReflective(true);
-	water.setReflectance(.5);
-	TexturedSphere moon(glm::vec3(0, 15, -100), 7, moonTex, ofColor::black, ofDegToRad(90));
-
-	TransparentSphere halo(glm::vec3(0, 13.5, -90), 12, ofColor(255, 255, 255, 100));
-
-	Spotlight light(glm::vec3(0, 15, -55), 550, glm::vec3(0, 0, -1), ofDegToRad(45));
-
-	scene.addSceneObject(water);
-	scene.addSceneObject(stars);
-	scene.addSceneObject(moon);
-	scene.addSceneObject(halo);
-
-	scene.addLight(light);
+	loadSceneByName("moon", scene);
 }
 
 //--------------------------------------------------------------
 
 ofImage ofApp::renderScene()
 {
-	auto t1 = std::chrono::high_resolution_clock::now();
-
 	int width = ofGetWidth();
 	int height = ofGetHeight();
 
 	ofImage img;
-	img.allocate(width, height, OF_IMAGE_COLOR);
 
 	if (whatToRender == RenderObjectType::SCENE) //only ray trace the scene if it is currently being displayed
 	{
-		for (int x = 0; x < width; x++)
-		{
-			for (int y = 0; y < height; y++)
-			{
-				glm::vec3 screen3DPt = sceneCam.screenToWorld(glm::vec3(x, y, 0));
-				glm::vec3 rayOrigin = sceneCam.getPosition();
-				glm::vec3 rayDir = glm::normalize(screen3DPt - rayOrigin);
+		Renderer renderer(scene, renderSettings);
+		img.setFromPixels(renderer.render(PinholeCamera(sceneCam, width, height)));
+	}
+	else
+	{
+		img.allocate(width, height, OF_IMAGE_COLOR);
+	}
 
-				Ray ray(rayOrigin, rayDir);
+	return img;
+}
 
-				ofColor colorAtPixel = scene.intersectRayScene(ray);
+void ofApp::startProgressiveRender(const string& filename)
+{
+	//the scene can't be changed while the render thread is reading it, so this also has to happen here rather than on the render thread
+	scene.finalize();
 
-				img.setColor(x, y, colorAtPixel);
-			}
-			//TODO: this is buggy, fix it
-			cout << left << setw(5) <<  x * 100.f / width << "% Complete\r";
-		}
-		cout << endl;
-	}
+	stopProgressiveRender();
+
+	PinholeCamera camera(sceneCam, ofGetWidth(), ofGetHeight());
+	rendering = true;
+	showPreview = true;
 
-	auto t2 = std::chrono::high_resolution_clock::now();
-	auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+	renderThread = std::thread([this, camera, filename]()
+	{
+		Renderer renderer(scene, renderSettings);
 
-	cout << "Ray tracing took " << duration << " milliseconds" << endl;
+		ofPixels pixels = renderer.renderProgressive(camera, [this](const ofPixels& passPixels, int, int)
+		{
+			std::lock_guard<std::mutex> guard(previewLock);
+			previewPixels = passPixels;
+			previewUpdated = true;
+		}, &cancelRender);
 
-	return img;
+		if (!cancelRender)
+		{
+			ofSaveImage(pixels, filename);
+			renderer.getStats().saveJson(RenderStats::pathForImage(filename));
+			cout << "Rendering complete. Image saved to " << filename << endl;
+		}
+
+		rendering = false;
+	});
+}
+
+void ofApp::stopProgressiveRender()
+{
+	if (renderThread.joinable())
+	{
+		cancelRender = true;
+		renderThread.join();
+		cancelRender = false;
+	}
 }
 
 //--------------------------------------------------------------
@@ -144,8 +145,15 @@ void ofApp::setup()
 }
 
 //--------------------------------------------------------------
-void ofApp::update(){
+void ofApp::update()
+{
+	std::lock_guard<std::mutex> guard(previewLock);
 
+	if (previewUpdated)
+	{
+		previewTexture.loadData(previewPixels);
+		previewUpdated = false;
+	}
 }
 
 //--------------------------------------------------------------
@@ -176,11 +184,32 @@ void ofApp::draw()
 	}
 	
 	cam->end();
+
+	//the preview stays up after the render finishes, until a key is pressed
+	if (showPreview && previewTexture.isAllocated())
+	{
+		ofSetColor(ofColor::white);
+		previewTexture.draw(0, 0, ofGetWidth(), ofGetHeight());
+	}
+}
+
+void ofApp::exit()
+{
+	stopProgressiveRender();
 }
 
 //--------------------------------------------------------------
 void ofApp::keyPressed(int key)
 {
+	//the scene and the things drawn over it can't change until the render thread is done with them
+	if (rendering)
+	{
+		cout << "Still rendering, please wait until the render is done" << endl;
+		return;
+	}
+
+	showPreview = false;
+
 	if (key == 'c')
 	{
 		if (cam == &easyCam)
@@ -196,9 +225,17 @@ void ofApp::keyPressed(int key)
 	{
 		string filename = "renderedScene.png";
 		cout << "Rendering scene using ray tracing..." << endl;
-		ofImage img = renderScene();
-		img.save(filename);
-		cout << "Rendering complete. Image saved to " << filename << endl;
+
+		if (whatToRender == RenderObjectType::SCENE)
+		{
+			startProgressiveRender(filename);
+		}
+		else
+		{
+			ofImage img = renderScene();
+			img.save(filename);
+			cout << "Rendering complete. Image saved to " << filename << endl;
+		}
 	}
 	else
 		loadMesh(key);
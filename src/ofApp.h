@@ -2,7 +2,11 @@
 
 #include "ofMain.h"
 #include "Scene.h"
+#include "Renderer.h"
 #include "GraphicalStructs.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 /**
  * @author Jordan Conragan
@@ -23,9 +27,17 @@ class ofApp : public ofBaseApp {
 
 		ofImage renderScene();
 
+		/// <summary>
+		/// Starts ray tracing the scene in the background. Every progressive pass is shown in the window as soon as it finishes,
+		/// and the final image is saved to filename
+		/// </summary>
+		void startProgressiveRender(const string& filename);
+		void stopProgressiveRender();
+
 		void setup();
 		void update();
 		void draw();
+		void exit();
 
 		void keyPressed(int key);
 		void keyReleased(int key);
@@ -50,7 +62,19 @@ class ofApp : public ofBaseApp {
 		RenderObjectType whatToRender;
 
 		Scene scene;
+		RenderSettings renderSettings;
 		Mesh m;
 
 		int selectedVert;
+
+		//progressive rendering. The render thread hands each finished pass to update() through previewPixels, since textures can only be uploaded from the main thread
+		std::thread renderThread;
+		std::atomic<bool> rendering{ false };
+		std::atomic<bool> cancelRender{ false };
+		std::mutex previewLock;
+		ofPixels previewPixels;
+		bool previewUpdated = false;
+
+		ofTexture previewTexture;
+		bool showPreview = false;
 };